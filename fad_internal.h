@@ -14,6 +14,11 @@
 
 
 #include <linux/miscdevice.h>
+#include <linux/kfifo.h>
+#include <linux/workqueue.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/regulator/consumer.h>
 
 enum {
 	RESTART_REASON_NOT_SET = 0x00,
@@ -28,15 +33,186 @@ enum POWER_STATE {
 	USB_CHARGE_STATE
 };
 
-enum WAKE_REASON {
-	UNKNOWN_WAKE,
-	ON_OFF_BUTTON_WAKE,
-	USB_CABLE_WAKE
-};
-
 extern DWORD g_RestartReason;
 
 struct alarm;
+struct faddata;
+struct dentry;
+struct led_classdev_mc;
+
+// Number of event records buffered per open file
+#define FAD_CLIENT_EVENTS	32
+
+// Max time suspend is blocked by an unread wakeup event [ms]
+#define FAD_WAKEUP_HOLD_MS	10000
+
+// Input lines that may wake the camera, bits in wakeArmed
+enum fad_wake_line {
+	FAD_WAKE_LASER,
+	FAD_WAKE_TRIGGER,
+};
+
+// Per open file state of /dev/fad0
+struct fadclient {
+	struct list_head node;
+	struct faddata *data;
+	BOOL bRecords;		// read() returns FADDEVEVENT records
+	USHORT usFlags;		// Flags to put in next queued record
+	DECLARE_KFIFO(events, FADDEVEVENT, FAD_CLIENT_EVENTS);
+
+	// Standby handshake, registered with IOCTL_FAD_REGISTER_PM_CLIENT
+	struct list_head pm_node;	// in faddata.pm_clients
+	char pmName[FAD_PM_CLIENT_NAME_LEN];
+	UINT32 pmTimeoutMs;		// 0 when not registered
+	BOOL bPmPending;		// Waiting for this client's ack, see pm_pending
+	unsigned long pmDeadline;	// jiffies, end of wait for this client's ack
+	UINT32 wakeUnread;		// Queued FAD_EVENT_FLAG_WAKEUP records
+};
+
+// Trigger press classification state
+struct fad_trigger {
+	ktime_t edge;		// Time of last edge, taken in hard irq
+	ktime_t first_edge;	// Time of first edge not yet seen by the irq thread
+	UINT32 edges;		// Edges not yet seen by the irq thread
+	ktime_t wake_edge;	// Time of edge that woke the camera
+	BOOL bWakeEdge;		// Last edge woke the camera
+	ktime_t press;		// Time of last press
+	ktime_t release;	// Time of last release
+	BOOL bPressed;		// Written by the irq thread only, READ_ONCE elsewhere
+	BOOL bLongPress;	// Long press reported for current press
+	BOOL bNested;		// Irq has no hard handler, edges taken in thread
+	spinlock_t lock;	// protects edge counting, press_count and press for readers
+	UINT32 press_count;
+	UINT32 long_press_ms;
+	UINT32 double_press_ms;
+	struct delayed_work long_work;
+};
+
+// Focus module supplies, enabled in parallel. Each is optional, the
+// ones found are packed first in focus_supplies.
+enum {
+	FAD_SUPPLY_OPTICS,
+	FAD_SUPPLY_POSITION_SENSOR,
+	FAD_SUPPLY_RING_SENSOR,
+	FAD_FOCUS_SUPPLIES
+};
+
+// Default power domain off delay, DT power-off-delay-ms overrides
+#define FAD_PD_OFF_DELAY_MS	2000
+
+// Power domain consumers, each holds a domain at most once
+enum fad_pd_consumer {
+	FAD_PD_RUN,		// Camera running, dropped in charge mode
+	FAD_PD_FOCUS,		// Focus subsystem request
+	FAD_PD_RUNTIME,		// Device runtime active, see fad_runtime_suspend()
+	FAD_PD_CONSUMERS
+};
+
+// KAKA LED pattern engine, see fad_led.c
+struct fad_led_pattern {
+	u32 repeat;		// 0 = until stopped
+	u32 steps;
+	FADDEVLEDSTEP step[FAD_LED_MAX_STEPS];
+};
+
+struct fad_led_engine {
+	struct mutex lock;	// protects all but timer and work
+	struct hrtimer timer;	// Step deadline, queues work
+	struct work_struct work;	// Applies next step, LED writes may sleep
+	ktime_t next;		// Expiry of current step
+	struct fad_led_pattern patterns[FAD_LED_MAX_PATTERNS];	// Uploaded
+	struct fad_led_pattern cur;	// Running copy
+	u32 step;
+	u32 loops;
+	BOOL bRunning;
+	int flashState;		// LED_FLASH_xxx when running a legacy flash mode
+	u8 red;			// Last written KAKA levels
+	u8 green;
+};
+
+// Keypad backlight levels and fade, see fad_keypad.c
+#define FAD_KP_MAX_LEVELS	8
+
+enum fad_kp_curve {
+	FAD_KP_CURVE_LINEAR,
+	FAD_KP_CURVE_EASE_IN_OUT,	// Smoothstep, soft start and end
+	FAD_KP_CURVE_PERCEPTUAL,	// Quadratic, evenly spaced steps to the eye
+};
+
+struct fad_kp_fade {
+	struct mutex lock;	// Serializes start/stop, work runs unlocked
+	struct delayed_work work;
+	int from;
+	int to;
+	ktime_t start;
+	u32 duration_ms;
+	int curve;		// enum fad_kp_curve
+};
+
+// Laser output lines, bits in laserInhibit
+enum fad_laser_line {
+	FAD_LASER_SOFT,
+	FAD_LASER_SWITCH,
+};
+
+// Paths switching FAD_LOAD_LASER independently, see fad_load_src_set()
+enum fad_laser_src {
+	FAD_LASER_SRC_SWITCH,	// Laser pointer switch
+	FAD_LASER_SRC_ACTIVE,	// Laser distance module active
+	FAD_LASER_SRC_SAMPLE,	// Laser distance sampling shot
+};
+
+// Reasons to pause laser distance sampling, see fad_ldm_pause_sampling()
+enum fad_ldm_pause {
+	FAD_LDM_PAUSE_SUSPEND,
+	FAD_LDM_PAUSE_CHARGE,
+};
+
+// Charge-only power profile from DT, see SetChargeProfile()
+#define FAD_CHARGE_DOMAINS	4
+
+struct fad_charge_profile {
+	struct fad_power_domain *pd[FAD_CHARGE_DOMAINS];
+	int num_pd;
+	unsigned long laser_lines;	// BIT(FAD_LASER_xxx) turned off
+	BOOL bLedRed;		// KAKA channels turned off
+	BOOL bLedGreen;
+	u8 led_red;		// KAKA levels at charge entry
+	u8 led_green;
+	struct fad_led_pattern led_pattern;	// Engine pattern running at charge entry
+	int led_flash;
+	BOOL bLedPattern;
+	BOOL bActive;
+};
+
+// On-time accounting per FAD_LOAD_E, see fad_stats.c
+struct fad_load_stat {
+	BOOL bOn;
+	unsigned long sources;	// BIT(source) holding the load on
+	ktime_t since;		// CLOCK_BOOTTIME of last switch on
+	u64 on_ns;		// Accumulated, excluding current on period
+	u32 transitions;
+};
+
+// Refcounted set of regulators with delayed power off, see fad_power.c
+struct fad_power_domain {
+	struct list_head node;
+	struct device *dev;
+	struct __FAD_HW_INDEP_INFO *gpDev;
+	const char *name;
+	int load;			// FAD_LOAD_xxx accounted, -1 for none
+	struct regulator_bulk_data *supplies;
+	int num_supplies;
+	struct mutex lock;
+	unsigned long consumers;	// BIT(FAD_PD_xxx) holding the domain
+	BOOL bOn;
+	BOOL bSuspended;		// Off since system suspend, not yet resumed
+	BOOL bInhibited;		// Forced off by charge profile
+	unsigned int off_delay_ms;
+	struct delayed_work off_work;
+	unsigned int power_cycles;	// Times powered off
+	unsigned int kept_warm;		// Delayed power offs cancelled
+};
 
 // Generic GPIO definitions
 #define LASER_ON			((7-1)*32 + 7)
@@ -52,16 +228,44 @@ typedef struct __FAD_HW_INDEP_INFO {
 	struct i2c_adapter *hI2C2;
 	struct completion standbyComplete;
 	BOOL bLaserEnable;	// True when laser enable active
+	struct mutex laserLock;	// Serializes laser output gating, see updateLaserPointerOutput()
+	BOOL bLaserActive;	// Laser soft on requested, under laserLock
+	unsigned long laserInhibit;	// BIT(FAD_LASER_xxx) kept off, under laserLock
 	PVOID pWdog;		// Pointer to Watchdog CPU registers
-	UINT8 Keypad_bl_low;
-	UINT8 Keypad_bl_medium;
-	UINT8 Keypad_bl_high;
+	u32 kpLevels[FAD_KP_MAX_LEVELS];	// Brightness of steps 1..n, see fad_kp_levels_init()
+	u32 kpThresholds[FAD_KP_MAX_LEVELS - 1];
+	int kpNumLevels;
 	struct led_classdev *red_led_cdev;
 	struct led_classdev *blue_led_cdev;
+	struct led_classdev_mc *kaka_mc;	// Replaces red/blue_led_cdev when set
+	int kaka_mc_red;	// kaka_mc subled_info index
+	int kaka_mc_green;
+	struct fad_led_engine ledEngine;
+	struct fad_kp_fade kpFade;
 
 	// Wait for IRQ variables
 	FAD_EVENT_E eEvent;
 	wait_queue_head_t wq;
+	spinlock_t clientLock;	// protects clients and their event fifos
+	struct list_head clients;
+	DWORD ulEventSeq;
+
+	struct fad_trigger trigger;
+
+	// Wakeup capable input IRQs
+	BOOL bLaserWakeup;
+	BOOL bTriggerWakeup;
+	unsigned long wakeEnabled;	// BIT(FAD_WAKE_xxx) with enable_irq_wake()
+	unsigned long wakeArmed;	// BIT(FAD_WAKE_xxx) armed, cleared by first edge
+	struct wakeup_source *ws;	// Held until wakeup event is read by all clients
+	UINT32 wakeUnread;	// Unread wakeup events, sum of clients + bWakeLegacy
+	BOOL bWakeLegacy;	// eEvent is an unread wakeup event
+
+	struct list_head power_domains;
+	UINT32 pdOffDelayMs;	// Power domain off hysteresis
+
+	spinlock_t loadLock;	// protects loads
+	struct fad_load_stat loads[FAD_LOADS];
 
 #ifdef CONFIG_OF
 	int laser_on_gpio;
@@ -72,10 +276,14 @@ typedef struct __FAD_HW_INDEP_INFO {
 	int trigger_gpio;
 
 	struct regulator *reg_opt3v6;
-	struct regulator *reg_optics_power;
-	struct regulator *reg_position_sensor;
-	struct regulator *reg_ring_sensor;
-	struct regulator *reg_motor_sleep;
+	struct regulator_bulk_data focus_supplies[FAD_FOCUS_SUPPLIES];
+	struct regulator_bulk_data motor_supply;
+	struct fad_power_domain pdFocus;
+	struct fad_power_domain pdMotor;
+	BOOL bHasFocusSupplies;
+	BOOL bHasMotorSupply;
+	BOOL bMotorLazyResume;	// Motor rail left off at resume until requested
+	struct fad_charge_profile chargeProfile;
 
 	struct led_classdev *pijk_cdev;
 	struct led_classdev *pike_cdev;
@@ -125,30 +333,170 @@ typedef struct __FAD_HW_INDEP_INFO {
 					  PFADDEVIOCTLSUBJBACKLIGHT pBacklight);
 	 DWORD (*pSetKeypadSubjBacklight)(struct __FAD_HW_INDEP_INFO *gpDev,
 					  PFADDEVIOCTLSUBJBACKLIGHT pBacklight);
+	void (*pSetKeypadLevel)(struct __FAD_HW_INDEP_INFO *gpDev, int brightness);
+	int (*pGetKeypadLevel)(struct __FAD_HW_INDEP_INFO *gpDev);
 	 BOOL (*pSetGPSEnable)(BOOL enabled);
 	 BOOL (*pGetGPSEnable)(BOOL *enabled);
 	int (*pSetChargerSuspend)(struct __FAD_HW_INDEP_INFO *gpDev,
 				  BOOL suspend);
+	int (*pSetFocusMotor)(struct __FAD_HW_INDEP_INFO *gpDev, BOOL on);
+	int (*pSetChargeProfile)(struct __FAD_HW_INDEP_INFO *gpDev, BOOL charge);
 	void (*pWdogInit)(struct __FAD_HW_INDEP_INFO *gpDev, UINT32 Timeout);
 	 BOOL (*pWdogService)(struct __FAD_HW_INDEP_INFO *gpDev);
 	void (*pCleanupHW)(struct __FAD_HW_INDEP_INFO *gpDev);
 	int (*suspend)(struct __FAD_HW_INDEP_INFO *gpDev);
 	int (*resume)(struct __FAD_HW_INDEP_INFO *gpDev);
+	int (*runtime_suspend)(struct __FAD_HW_INDEP_INFO *gpDev);
+	int (*runtime_resume)(struct __FAD_HW_INDEP_INFO *gpDev);
 } FAD_HW_INDEP_INFO, *PFAD_HW_INDEP_INFO;
 
+// Suspend/resume phases timed by fad_pm_mark()
+enum fad_pm_phase {
+	FAD_PM_PREPARE,		// PM_SUSPEND_PREPARE entered
+	FAD_PM_ACKED,		// Standby acks received
+	FAD_PM_ALARM,		// Standby alarm armed
+	FAD_PM_SUSPEND,		// fad_suspend entered
+	FAD_PM_SUSPENDED,	// Regulators off
+	FAD_PM_RESUME,		// fad_resume entered
+	FAD_PM_RESUMED,		// Regulators on
+	FAD_PM_POST_SUSPEND,	// PM_POST_SUSPEND entered
+	FAD_PM_WAKE_REASON,	// Wake reason known
+	FAD_PM_PHASES
+};
+
+// Number of suspend/resume cycles kept for debugfs
+#define FAD_PM_CYCLES	32
+
+struct fad_pm_timing {
+	spinlock_t lock;
+	ktime_t cur[FAD_PM_PHASES];	// CLOCK_BOOTTIME, 0 if phase not passed
+	ktime_t cycles[FAD_PM_CYCLES][FAD_PM_PHASES];
+	unsigned int count;		// Completed cycles
+};
+
+// Wakeup source to wake reason mapping, see fad_wake.c
+#define FAD_WAKE_SOURCES	8
+#define FAD_WAKE_REASONS	(INPUT_WAKE + 1)
+
+struct fad_wake_source {
+	const char *name;
+	int reason;			// WAKE_REASON
+	struct wakeup_source *ws;	// NULL until resolved
+};
+
 struct faddata {
 	struct miscdevice miscdev;
 	struct device *dev;
 	FAD_HW_INDEP_INFO pDev;
 	struct alarm alarm;
 	struct notifier_block nb;
+	int wake_reason;	// Reason for last wakeup from standby
+	struct fad_wake_source wake_sources[FAD_WAKE_SOURCES];
+	int num_wake_sources;
+	int last_wake;		// Classified reason of last wakeup, incl. RTC_WAKE
+	unsigned int wake_counts[FAD_WAKE_REASONS];
+	ktime_t standby_off_at;	// CLOCK_REALTIME standby power off, 0 if timed wakeup
+	BOOL bDarkResume;	// Woke only to power off, userspace not notified
+	BOOL bStandbyTimeout;	// Standby power off alarm fired
+	BOOL bBacklightInstantOn;	// Blank at standby, restore in fad_resume
+	BOOL bBacklightSaved;	// bl_power/bl_brightness valid, backlight blanked
+	int bl_power;
+	int bl_brightness;
+	ktime_t timelapse_at;	// CLOCK_REALTIME next timelapse wake, 0 if none
+	BOOL bTimelapseResuspend;	// Window over, alarm armed, next suspend without handshake
+	BOOL bTimelapseWindow;	// In wake window
+	unsigned int timelapse_count;
+	struct delayed_work timelapse_work;	// Pending while in wake window
+	struct work_struct timelapse_alarm_work;	// Timelapse alarm fired
+	struct wakeup_source *timelapse_ws;	// Held during wake window
+	struct mutex pm_lock;	// protects pm_clients, pm_pending and timelapse state,
+				// not held while waiting
+	struct list_head pm_clients;
+	unsigned int pm_pending;	// Clients with bPmPending
+	wait_queue_head_t pm_wq;	// Woken when pm_pending drops
+	struct fad_pm_timing pm_timing;
+	BOOL bLaserRuntime;	// Runtime PM reference held while laser active
+	BOOL bMotorRuntime;	// Runtime PM reference held while motor powered
+	struct dentry *debugfs;
 };
 
 // Function prototypes - fad_irq.c (Input pin interrupt handling)
 int InitLaserIrq(PFAD_HW_INDEP_INFO gpDev);
 void FreeLaserIrq(PFAD_HW_INDEP_INFO gpDev);
-irqreturn_t fadTriggerIST(int irq, void *dev_id);
+int InitTriggerIrq(PFAD_HW_INDEP_INFO gpDev);
+void FreeTriggerIrq(PFAD_HW_INDEP_INFO gpDev);
 void ApplicationEvent(PFAD_HW_INDEP_INFO gpDev, FAD_EVENT_E event);
+void ApplicationEventFlags(PFAD_HW_INDEP_INFO gpDev, FAD_EVENT_E event, USHORT flags);
+void ApplicationEventRecord(PFAD_HW_INDEP_INFO gpDev, FAD_EVENT_E event,
+			    ktime_t ts, DWORD data0, DWORD data1);
+void ApplicationEventRecordFlags(PFAD_HW_INDEP_INFO gpDev, FAD_EVENT_E event,
+				 ktime_t ts, USHORT flags, DWORD data0, DWORD data1);
+int InitIrqWake(PFAD_HW_INDEP_INFO gpDev);
+void FreeIrqWake(PFAD_HW_INDEP_INFO gpDev);
+void SetIrqWake(PFAD_HW_INDEP_INFO gpDev, BOOL on);
+void RelaxIrqWake(PFAD_HW_INDEP_INFO gpDev, struct fadclient *client);
+
+// Function prototypes - fad_wake.c (Wake reason classification)
+void fad_wake_init(struct faddata *data);
+int fad_wake_classify(struct faddata *data, struct wakeup_source *ws);
+void fad_wake_count(struct faddata *data, int reason);
+const char *fad_wake_reason_name(int reason);
+
+// Function prototypes - fad_stats.c (Load on-time accounting)
+void fad_stats_init(struct faddata *data);
+void fad_load_set(PFAD_HW_INDEP_INFO gpDev, int load, BOOL on);
+void fad_load_src_set(PFAD_HW_INDEP_INFO gpDev, int load, int src, BOOL on);
+void fad_load_snapshot(PFAD_HW_INDEP_INFO gpDev, PFADDEVIOCTLLOADSTATS pStats);
+
+// Function prototypes - fad_led.c (LED lookup and pattern engine)
+int fad_led_get(struct device *dev, const char *con_id, const char *legacy,
+		struct led_classdev **led);
+int fad_led_get_kaka(PFAD_HW_INDEP_INFO gpDev, struct device *dev,
+		     const char *red_legacy, const char *green_legacy);
+struct led_classdev *fad_led_kaka_cdev(PFAD_HW_INDEP_INFO gpDev);
+BOOL fad_led_has_kaka(PFAD_HW_INDEP_INFO gpDev, BOOL *red, BOOL *green);
+void fad_led_set_kaka(PFAD_HW_INDEP_INFO gpDev, u8 red, u8 green);
+void fad_led_kaka_levels(PFAD_HW_INDEP_INFO gpDev, u8 *red, u8 *green);
+void fad_led_init(PFAD_HW_INDEP_INFO gpDev);
+void fad_led_exit(PFAD_HW_INDEP_INFO gpDev);
+int fad_led_set_pattern(PFAD_HW_INDEP_INFO gpDev, const FADDEVIOCTLLEDPATTERN *pPattern);
+int fad_led_start_id(PFAD_HW_INDEP_INFO gpDev, u32 id);
+void fad_led_start(PFAD_HW_INDEP_INFO gpDev, const struct fad_led_pattern *pattern,
+		   int flashState);
+void fad_led_stop(PFAD_HW_INDEP_INFO gpDev);
+BOOL fad_led_running(PFAD_HW_INDEP_INFO gpDev, struct fad_led_pattern *pattern,
+		     int *flashState);
+int fad_led_flash_state(PFAD_HW_INDEP_INFO gpDev);
+void fad_led_in_use(PFAD_HW_INDEP_INFO gpDev, BOOL *red, BOOL *blue);
+
+// Function prototypes - fad_keypad.c (Keypad backlight levels and fade)
+void fad_kp_levels_init(PFAD_HW_INDEP_INFO gpDev);
+int fad_kp_step_to_brightness(PFAD_HW_INDEP_INFO gpDev, u32 step);
+u32 fad_kp_brightness_to_step(PFAD_HW_INDEP_INFO gpDev, u32 brightness);
+int fad_kp_subj_to_brightness(PFAD_HW_INDEP_INFO gpDev, SUBJ_KEYPAD_BACKL_E subj);
+SUBJ_KEYPAD_BACKL_E fad_kp_brightness_to_subj(PFAD_HW_INDEP_INFO gpDev, u32 brightness);
+void fad_kp_init(PFAD_HW_INDEP_INFO gpDev);
+void fad_kp_exit(PFAD_HW_INDEP_INFO gpDev);
+int fad_kp_fade(PFAD_HW_INDEP_INFO gpDev, u32 brightness, u32 duration_ms, int curve);
+void fad_kp_fade_stop(PFAD_HW_INDEP_INFO gpDev);
+
+// Function prototypes - fad_pm.c (Suspend/resume instrumentation)
+void fad_pm_init(struct faddata *data);
+void fad_pm_mark(struct faddata *data, enum fad_pm_phase phase);
+
+// Function prototypes - fad_power.c (Power domains)
+void fad_power_init(struct faddata *data);
+void fad_pd_init(PFAD_HW_INDEP_INFO gpDev, struct fad_power_domain *pd,
+		 const char *name, struct regulator_bulk_data *supplies,
+		 int num_supplies, int load);
+void fad_pd_exit(struct fad_power_domain *pd);
+int fad_pd_get(struct fad_power_domain *pd, enum fad_pd_consumer consumer);
+int fad_pd_put(struct fad_power_domain *pd, enum fad_pd_consumer consumer);
+int fad_pd_suspend(struct fad_power_domain *pd);
+int fad_pd_resume(struct fad_power_domain *pd);
+void fad_pd_set_off_delay(PFAD_HW_INDEP_INFO gpDev, unsigned int ms);
+int fad_pd_inhibit(struct fad_power_domain *pd, BOOL inhibit);
+struct fad_power_domain *fad_pd_find(PFAD_HW_INDEP_INFO gpDev, const char *name);
 
 // Function prototypes - fad_io.c (Misc IO handling, both I2C and GPIO)
 int SetupMX51(PFAD_HW_INDEP_INFO gpDev);
@@ -169,9 +517,18 @@ void getLaserPointerStatus(PFAD_HW_INDEP_INFO gpDev, PFADDEVIOCTLLASER pLaserSta
 void updateLaserPointerOutput(PFAD_HW_INDEP_INFO gpDev);
 void SetLaserPointerActive(PFAD_HW_INDEP_INFO gpDev, BOOL on);
 BOOL GetLaserPointerActive(PFAD_HW_INDEP_INFO gpDev);
+void SetLaserPointerInhibit(PFAD_HW_INDEP_INFO gpDev, unsigned long lines);
 
 // Function prototypes laser distance meter
 int SetupLaserDistance(PFAD_HW_INDEP_INFO gpDev);
+void InvSetupLaserDistance(PFAD_HW_INDEP_INFO gpDev);
+u32 fad_ldm_get_max_rate(void);
+void fad_ldm_set_max_rate(u32 hz);
+u32 fad_ldm_get_sample_interval(void);
+void fad_ldm_set_sample_interval(u32 ms);
+void fad_ldm_pause_sampling(enum fad_ldm_pause reason, BOOL pause);
+u32 fad_ldm_get_max_duty(void);
+int fad_ldm_set_max_duty(u32 pct);
 void setLaserDistanceStatus(PFAD_HW_INDEP_INFO gpDev, BOOL on);
 void getLaserDistanceStatus(PFAD_HW_INDEP_INFO gpDev, PFADDEVIOCTLLASER pLaserStatus);
 void SetLaserDistanceActive(PFAD_HW_INDEP_INFO gpDev, BOOL on);
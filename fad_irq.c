@@ -18,11 +18,18 @@
 #include <linux/irq.h>
 #include <linux/platform_device.h>
 #include <linux/irq.h>
+#include <linux/pm_wakeup.h>
 #include "flir-kernel-version.h"
 #include "linux/of_gpio.h"
 
+// Edges merged faster than this are contact bounce, not a press [ms]
+#define FAD_TRIGGER_DEBOUNCE_MS	5
+
 // Internal function prototypes
 static irqreturn_t fadLaserIST(int irq, void *dev_id);
+static irqreturn_t fadTriggerISR(int irq, void *dev_id);
+static irqreturn_t fadTriggerIST(int irq, void *dev_id);
+static void fadTriggerLongPress(struct work_struct *work);
 
 // Code
 
@@ -45,9 +52,10 @@ int InitLaserIrq(PFAD_HW_INDEP_INFO gpDev)
 	pin = LASER_ON;
 #endif
 	if (gpDev->bHasLaser) {
-		ret = request_irq(gpio_to_irq(pin), fadLaserIST,
-				  IRQF_TRIGGER_FALLING | IRQF_TRIGGER_RISING,
-				  "LaserON", gpDev);
+		// Threaded, output gating reads and sets GPIOs that may sleep
+		ret = request_threaded_irq(gpio_to_irq(pin), NULL, fadLaserIST,
+					   IRQF_TRIGGER_FALLING | IRQF_TRIGGER_RISING |
+					   IRQF_ONESHOT, "LaserON", gpDev);
 	}
 	if (ret) {
 		pr_err
@@ -72,12 +80,268 @@ void FreeLaserIrq(PFAD_HW_INDEP_INFO gpDev)
 	}
 }
 
-void ApplicationEvent(PFAD_HW_INDEP_INFO gpDev, FAD_EVENT_E event)
+/**
+ * InitTriggerIrq
+ *
+ * Initialize trigger irq on both edges, trigger_gpio must be requested
+ *
+ * @param gpDev
+ *
+ * @return retval
+ */
+int InitTriggerIrq(PFAD_HW_INDEP_INFO gpDev)
+{
+	int ret;
+	int irq = gpio_to_irq(gpDev->trigger_gpio);
+
+	INIT_DELAYED_WORK(&gpDev->trigger.long_work, fadTriggerLongPress);
+	gpDev->trigger.bPressed = (gpio_get_value_cansleep(gpDev->trigger_gpio) == 0);
+	// Behind a sleeping expander the irq is nested, only the thread runs
+	gpDev->trigger.bNested = gpio_cansleep(gpDev->trigger_gpio);
+
+	// Not oneshot, the hard irq must count edges while the thread runs
+	ret = request_threaded_irq(irq, fadTriggerISR, fadTriggerIST,
+				   IRQF_TRIGGER_FALLING | IRQF_TRIGGER_RISING,
+				   "TriggerGPIO", gpDev);
+	if (ret)
+		pr_err("flridrv-fad: Failed to register interrupt for trigger...\n");
+	else
+		pr_debug("flirdrv-fad: Registered interrupt %i for trigger\n", irq);
+	return ret;
+}
+
+void FreeTriggerIrq(PFAD_HW_INDEP_INFO gpDev)
+{
+	free_irq(gpio_to_irq(gpDev->trigger_gpio), gpDev);
+	cancel_delayed_work_sync(&gpDev->trigger.long_work);
+}
+
+/**
+ * InitIrqWake
+ *
+ * Register wakeup source if any input line may wake the camera,
+ * call after platform setup has read bXxxWakeup
+ *
+ * @param gpDev
+ *
+ * @return retval
+ */
+int InitIrqWake(PFAD_HW_INDEP_INFO gpDev)
+{
+	struct faddata *data = container_of(gpDev, struct faddata, pDev);
+
+	if (!gpDev->bLaserWakeup && !gpDev->bTriggerWakeup)
+		return 0;
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5,4,0)
+	gpDev->ws = wakeup_source_register("fad-input");
+#else
+	gpDev->ws = wakeup_source_register(data->dev, "fad-input");
+#endif
+	if (!gpDev->ws)
+		return -ENOMEM;
+	device_init_wakeup(data->dev, true);
+	return 0;
+}
+
+void FreeIrqWake(PFAD_HW_INDEP_INFO gpDev)
+{
+	struct faddata *data = container_of(gpDev, struct faddata, pDev);
+
+	if (!gpDev->ws)
+		return;
+	device_init_wakeup(data->dev, false);
+	wakeup_source_unregister(gpDev->ws);
+	gpDev->ws = NULL;
+}
+
+#ifdef CONFIG_OF
+static int fadWakeIrq(PFAD_HW_INDEP_INFO gpDev, int line)
+{
+	if (line == FAD_WAKE_LASER)
+		return gpio_to_irq(gpDev->laser_on_gpio);
+	return gpio_to_irq(gpDev->trigger_gpio);
+}
+#endif
+
+/**
+ * SetIrqWake
+ *
+ * Arm wakeup capable input IRQs at system suspend, disarm at resume.
+ * The first edge of an armed line is reported with FAD_EVENT_FLAG_WAKEUP.
+ *
+ * @param gpDev
+ * @param on
+ */
+void SetIrqWake(PFAD_HW_INDEP_INFO gpDev, BOOL on)
+{
+#ifdef CONFIG_OF
+	struct faddata *data = container_of(gpDev, struct faddata, pDev);
+	int line;
+
+	if (on) {
+		struct fadclient *client;
+		unsigned long irqflags;
+
+		if (!gpDev->ws || !device_may_wakeup(data->dev))
+			return;
+		// Wakeup events left unread when the hold timed out are stale
+		spin_lock_irqsave(&gpDev->clientLock, irqflags);
+		list_for_each_entry(client, &gpDev->clients, node)
+			client->wakeUnread = 0;
+		gpDev->wakeUnread = 0;
+		gpDev->bWakeLegacy = FALSE;
+		spin_unlock_irqrestore(&gpDev->clientLock, irqflags);
+		if (gpDev->bLaserWakeup && gpDev->laser_on_gpio)
+			gpDev->wakeEnabled |= BIT(FAD_WAKE_LASER);
+		if (gpDev->bTriggerWakeup && gpDev->trigger_gpio)
+			gpDev->wakeEnabled |= BIT(FAD_WAKE_TRIGGER);
+		gpDev->wakeArmed = gpDev->wakeEnabled;
+	}
+
+	for_each_set_bit(line, &gpDev->wakeEnabled, BITS_PER_LONG) {
+		if (on)
+			enable_irq_wake(fadWakeIrq(gpDev, line));
+		else
+			disable_irq_wake(fadWakeIrq(gpDev, line));
+	}
+
+	if (!on) {
+		gpDev->wakeEnabled = 0;
+		gpDev->wakeArmed = 0;
+	}
+#endif
+}
+
+/**
+ * Wakeup event consumed by a client, allow suspend again when every
+ * client has read it. Called with clientLock held.
+ *
+ * @param gpDev
+ * @param client  Reader of a wakeup record, NULL for the legacy event
+ */
+void RelaxIrqWake(PFAD_HW_INDEP_INFO gpDev, struct fadclient *client)
+{
+	if (client) {
+		if (!client->wakeUnread)
+			return;
+		client->wakeUnread--;
+	} else {
+		if (!gpDev->bWakeLegacy)
+			return;
+		gpDev->bWakeLegacy = FALSE;
+	}
+	if (!--gpDev->wakeUnread && gpDev->ws)
+		__pm_relax(gpDev->ws);
+}
+
+// Queue record, and legacy event if bLegacy
+static void fadQueueEvent(PFAD_HW_INDEP_INFO gpDev, FAD_EVENT_E event, ktime_t ts,
+			  USHORT flags, DWORD data0, DWORD data1, BOOL bLegacy)
 {
-	gpDev->eEvent = event;
+	struct fadclient *client;
+	FADDEVEVENT rec, old;
+	BOOL bWake = (flags & FAD_EVENT_FLAG_WAKEUP) != 0;
+	unsigned long irqflags;
+
+	rec.usEvent = event;
+	rec.ulData[0] = data0;
+	rec.ulData[1] = data1;
+	rec.ullTimestamp = ktime_to_ns(ts);
+
+	spin_lock_irqsave(&gpDev->clientLock, irqflags);
+	if (bWake && gpDev->ws)
+		__pm_wakeup_event(gpDev->ws, FAD_WAKEUP_HOLD_MS);
+	rec.ulSeq = ++gpDev->ulEventSeq;
+	list_for_each_entry(client, &gpDev->clients, node) {
+		if (!client->bRecords) {
+			// Legacy readers share eEvent, first read consumes it
+			if (bLegacy && bWake && !gpDev->bWakeLegacy) {
+				gpDev->bWakeLegacy = TRUE;
+				gpDev->wakeUnread++;
+			}
+			continue;
+		}
+		if (kfifo_is_full(&client->events)) {
+			if (kfifo_peek(&client->events, &old) &&
+			    (old.usFlags & FAD_EVENT_FLAG_WAKEUP))
+				RelaxIrqWake(gpDev, client);
+			kfifo_skip(&client->events);
+			client->usFlags |= FAD_EVENT_FLAG_OVERRUN;
+		}
+		rec.usFlags = client->usFlags | flags;
+		client->usFlags = 0;
+		kfifo_put(&client->events, rec);
+		if (bWake) {
+			client->wakeUnread++;
+			gpDev->wakeUnread++;
+		}
+	}
+	if (bLegacy)
+		gpDev->eEvent = event;
+	spin_unlock_irqrestore(&gpDev->clientLock, irqflags);
+
 	wake_up_interruptible(&gpDev->wq);
 }
 
+/**
+ * Legacy single byte event, also queued as a record
+ *
+ * @param gpDev
+ * @param event
+ */
+void ApplicationEvent(PFAD_HW_INDEP_INFO gpDev, FAD_EVENT_E event)
+{
+	ApplicationEventFlags(gpDev, event, 0);
+}
+
+/**
+ * Legacy single byte event, also queued as a record with FAD_EVENT_FLAG_xxx
+ *
+ * @param gpDev
+ * @param event
+ * @param flags  FAD_EVENT_FLAG_xxx
+ */
+void ApplicationEventFlags(PFAD_HW_INDEP_INFO gpDev, FAD_EVENT_E event, USHORT flags)
+{
+	fadQueueEvent(gpDev, event, ktime_get(), flags, 0, 0, TRUE);
+}
+
+/**
+ * Queue an event record to all clients reading records.
+ * If a client fifo is full the oldest record is dropped.
+ * Callable from atomic context.
+ *
+ * @param gpDev
+ * @param event
+ * @param ts     Time of event (CLOCK_MONOTONIC)
+ * @param data0  Event specific data
+ * @param data1  Event specific data
+ */
+void ApplicationEventRecord(PFAD_HW_INDEP_INFO gpDev, FAD_EVENT_E event,
+			    ktime_t ts, DWORD data0, DWORD data1)
+{
+	ApplicationEventRecordFlags(gpDev, event, ts, 0, data0, data1);
+}
+
+/**
+ * Queue an event record with FAD_EVENT_FLAG_xxx.
+ * A wakeup event keeps the system awake until read by every client,
+ * at most FAD_WAKEUP_HOLD_MS.
+ *
+ * @param gpDev
+ * @param event
+ * @param ts     Time of event (CLOCK_MONOTONIC)
+ * @param flags  FAD_EVENT_FLAG_xxx
+ * @param data0  Event specific data
+ * @param data1  Event specific data
+ */
+void ApplicationEventRecordFlags(PFAD_HW_INDEP_INFO gpDev, FAD_EVENT_E event,
+				 ktime_t ts, USHORT flags, DWORD data0, DWORD data1)
+{
+	fadQueueEvent(gpDev, event, ts, flags, data0, data1, FALSE);
+}
+
 irqreturn_t fadLaserIST(int irq, void *dev_id)
 {
 	PFAD_HW_INDEP_INFO gpDev = (PFAD_HW_INDEP_INFO) dev_id;
@@ -88,7 +352,14 @@ irqreturn_t fadLaserIST(int irq, void *dev_id)
 /* #else */
 /*	pin = LASER_ON */
 /* #endif */
-	ApplicationEvent(gpDev, FAD_LASER_EVENT);
+	// Gate beam first, userspace is only notified
+	if (gpDev->pUpdateLaserOutput)
+		gpDev->pUpdateLaserOutput(gpDev);
+
+	if (test_and_clear_bit(FAD_WAKE_LASER, &gpDev->wakeArmed))
+		ApplicationEventFlags(gpDev, FAD_LASER_EVENT, FAD_EVENT_FLAG_WAKEUP);
+	else
+		ApplicationEvent(gpDev, FAD_LASER_EVENT);
 	/* if (bWaitForNeg) { */
 	/*      irq_set_irq_type(gpio_to_irq(pin), */
 	/*                       IRQF_TRIGGER_LOW | IRQF_ONESHOT); */
@@ -102,16 +373,147 @@ irqreturn_t fadLaserIST(int irq, void *dev_id)
 	return IRQ_HANDLED;
 }
 
+/**
+ * Timestamp and count a trigger edge
+ */
+static void fadTriggerEdge(PFAD_HW_INDEP_INFO gpDev, ktime_t now)
+{
+	struct fad_trigger *trig = &gpDev->trigger;
+	unsigned long flags;
+
+	spin_lock_irqsave(&trig->lock, flags);
+	if (!trig->edges++)
+		trig->first_edge = now;
+	trig->edge = now;
+	spin_unlock_irqrestore(&trig->lock, flags);
+	if (test_and_clear_bit(FAD_WAKE_TRIGGER, &gpDev->wakeArmed)) {
+		trig->wake_edge = now;
+		trig->bWakeEdge = TRUE;
+	}
+}
+
+/**
+ * Trigger hard irq, only timestamps and counts the edge.
+ * Not called for a nested irq, see fadTriggerIST().
+ */
+irqreturn_t fadTriggerISR(int irq, void *dev_id)
+{
+	fadTriggerEdge((PFAD_HW_INDEP_INFO)dev_id, ktime_get());
+	return IRQ_WAKE_THREAD;
+}
+
+/**
+ * Trigger irq thread, classifies press/release/double press.
+ * Trigger is active low.
+ */
 irqreturn_t fadTriggerIST(int irq, void *dev_id)
 {
 	PFAD_HW_INDEP_INFO gpDev = (PFAD_HW_INDEP_INFO)dev_id;
 	struct faddata *data = container_of(gpDev, struct faddata, pDev);
 	struct device *dev = data->dev;
+	struct fad_trigger *trig = &gpDev->trigger;
+	ktime_t ts;
+	ktime_t first;
+	ktime_t rec_ts;
+	ktime_t press_ts;
+	UINT32 edges;
+	USHORT flags = 0;
+	BOOL pressed;
+	BOOL bReleased = FALSE;
+
+	// Nested irq runs once per edge, without the hard irq
+	if (trig->bNested)
+		fadTriggerEdge(gpDev, ktime_get());
+
+	spin_lock_irq(&trig->lock);
+	ts = trig->edge;
+	first = trig->first_edge;
+	edges = trig->edges;
+	trig->edges = 0;
+	spin_unlock_irq(&trig->lock);
+	rec_ts = ts;
+	press_ts = ts;
+
+	pressed = (gpio_get_value_cansleep(gpDev->trigger_gpio) == 0);
+	if (trig->bWakeEdge) {
+		trig->bWakeEdge = FALSE;
+		flags = FAD_EVENT_FLAG_WAKEUP;
+		rec_ts = trig->wake_edge;
+		// Press shorter than resume, report both press and release
+		if (!pressed && !trig->bPressed) {
+			pressed = TRUE;
+			bReleased = TRUE;
+		}
+	} else if (pressed == trig->bPressed) {
+		// Level is back where it was: bounce, or a whole press and
+		// release (release and press) that merged before the thread ran
+		if (edges < 2 || ktime_us_delta(ts, first) < FAD_TRIGGER_DEBOUNCE_MS * 1000)
+			return IRQ_HANDLED;
+		if (pressed) {
+			cancel_delayed_work(&trig->long_work);
+			trig->release = first;
+			ApplicationEventRecord(gpDev, FAD_TRIGGER_RELEASE_EVENT, first,
+					       (DWORD)ktime_us_delta(first, trig->press), 0);
+			WRITE_ONCE(trig->bPressed, FALSE);
+		} else {
+			pressed = TRUE;
+			bReleased = TRUE;
+			press_ts = first;
+			rec_ts = first;
+		}
+	}
+	if (pressed == trig->bPressed)
+		return IRQ_HANDLED;	// Bounce, edges merged
+	WRITE_ONCE(trig->bPressed, pressed);
+
+	if (pressed) {
+		s64 gap = ktime_us_delta(press_ts, trig->release);
+
+		ApplicationEventRecordFlags(gpDev, FAD_TRIGGER_PRESS_EVENT, rec_ts, flags, 0, 0);
+		if (trig->double_press_ms && ktime_to_ns(trig->release) &&
+		    !trig->bLongPress && gap <= trig->double_press_ms * 1000LL)
+			ApplicationEventRecord(gpDev, FAD_TRIGGER_DOUBLE_PRESS_EVENT,
+					       press_ts, (DWORD)gap, 0);
+		spin_lock_irq(&trig->lock);
+		trig->press = press_ts;
+		trig->press_count++;
+		spin_unlock_irq(&trig->lock);
+		trig->bLongPress = FALSE;
+		if (trig->long_press_ms && !bReleased)
+			schedule_delayed_work(&trig->long_work,
+					      msecs_to_jiffies(trig->long_press_ms));
 
 #if LINUX_VERSION_CODE < KERNEL_VERSION(5,10,0)
-	sysfs_notify(&dev->kobj, NULL, "trigger_poll");
+		sysfs_notify(&dev->kobj, NULL, "trigger_poll");
 #else
-	sysfs_notify(&dev->kobj, "control", "trigger_poll");
+		sysfs_notify(&dev->kobj, "control", "trigger_poll");
 #endif
+	}
+
+	if (!pressed || bReleased) {
+		cancel_delayed_work(&trig->long_work);
+		WRITE_ONCE(trig->bPressed, FALSE);
+		trig->release = ts;
+		ApplicationEventRecord(gpDev, FAD_TRIGGER_RELEASE_EVENT, ts,
+				       (DWORD)ktime_us_delta(ts, trig->press), 0);
+	}
+
 	return IRQ_HANDLED;
 }
+
+/**
+ * Report long press while trigger still held
+ */
+void fadTriggerLongPress(struct work_struct *work)
+{
+	struct fad_trigger *trig = container_of(to_delayed_work(work),
+						struct fad_trigger, long_work);
+	PFAD_HW_INDEP_INFO gpDev = container_of(trig, FAD_HW_INDEP_INFO, trigger);
+	ktime_t now = ktime_get();
+
+	if (!READ_ONCE(trig->bPressed))
+		return;
+	trig->bLongPress = TRUE;
+	ApplicationEventRecord(gpDev, FAD_TRIGGER_LONG_PRESS_EVENT, now,
+			       (DWORD)ktime_us_delta(now, trig->press), 0);
+}
@@ -0,0 +1,263 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/***********************************************************************
+ *
+ * Project: Balthazar
+ *
+ * Description of file:
+ *    FLIR Application Driver (FAD) keypad backlight levels and fade.
+ *
+ *    Keypad backlight steps come from DT "keypad-backlight-levels"
+ *    (ascending, any number up to FAD_KP_MAX_LEVELS), with midpoint
+ *    thresholds precomputed so brightness maps back to a step with a
+ *    binary search. Step 0 is off. The three KP_SUBJ_xxx levels map
+ *    onto the first, middle and last step.
+ *
+ *    Ramps the keypad backlight from its current to a target
+ *    brightness over a given time along a selectable curve, so a fade
+ *    is one call. Runs as delayed work since the keypad LEDs may sit
+ *    on I2C. Progress is computed from elapsed time, a late tick
+ *    catches up instead of stretching the fade.
+ *
+ *  FADDEV Copyright : FLIR Systems AB
+ ***********************************************************************/
+
+#include "flir_kernel_os.h"
+#include "faddev.h"
+#include "fad_internal.h"
+#include <linux/platform_device.h>
+#include <linux/leds.h>
+#include <linux/of.h>
+
+static const u32 fad_kp_default_levels[] = { 10, 40, 75 };
+
+#define FAD_KP_FADE_TICK_MS	16
+#define FAD_KP_FADE_ONE		1024	// Fixed point 1.0 for curve math
+
+/**
+ * Read level table from the FAD device node and precompute thresholds
+ *
+ * @param gpDev
+ */
+void fad_kp_levels_init(PFAD_HW_INDEP_INFO gpDev)
+{
+	int n = 0;
+	int i;
+#ifdef CONFIG_OF
+	struct faddata *data = container_of(gpDev, struct faddata, pDev);
+	struct device_node *np = data->dev->of_node;
+	int len;
+
+	if (np && of_find_property(np, "keypad-backlight-levels", &len)) {
+		n = len / sizeof(u32);
+		if (n > FAD_KP_MAX_LEVELS) {
+			pr_err("flirdrv-fad: keypad-backlight-levels has more than %d levels\n",
+			       FAD_KP_MAX_LEVELS);
+			n = 0;
+		} else if (of_property_read_u32_array(np, "keypad-backlight-levels",
+						      gpDev->kpLevels, n)) {
+			n = 0;
+		}
+	}
+	for (i = 1; i < n; i++) {
+		if (gpDev->kpLevels[i] <= gpDev->kpLevels[i - 1]) {
+			pr_err("flirdrv-fad: keypad-backlight-levels not ascending\n");
+			n = 0;
+			break;
+		}
+	}
+#endif
+	if (n <= 0) {
+		n = ARRAY_SIZE(fad_kp_default_levels);
+		memcpy(gpDev->kpLevels, fad_kp_default_levels, sizeof(fad_kp_default_levels));
+	}
+	gpDev->kpNumLevels = n;
+
+	// Brightness up to kpThresholds[i] is level i
+	for (i = 0; i < n - 1; i++)
+		gpDev->kpThresholds[i] = gpDev->kpLevels[i] +
+			(gpDev->kpLevels[i + 1] - gpDev->kpLevels[i]) / 2;
+}
+
+/**
+ * Brightness of step
+ *
+ * @param gpDev
+ * @param step  FAD_KP_STEP_OFF, 1..kpNumLevels
+ *
+ * @return brightness, -EINVAL for unknown step
+ */
+int fad_kp_step_to_brightness(PFAD_HW_INDEP_INFO gpDev, u32 step)
+{
+	if (step == FAD_KP_STEP_OFF)
+		return 0;
+	if (step > (u32)gpDev->kpNumLevels)
+		return -EINVAL;
+	return gpDev->kpLevels[step - 1];
+}
+
+/**
+ * Nearest step of brightness, also for brightness set through
+ * percentage ioctls that is not exactly a level.
+ *
+ * @param gpDev
+ * @param brightness
+ *
+ * @return FAD_KP_STEP_OFF, 1..kpNumLevels
+ */
+u32 fad_kp_brightness_to_step(PFAD_HW_INDEP_INFO gpDev, u32 brightness)
+{
+	int lo = 0;
+	int hi = gpDev->kpNumLevels - 1;
+
+	if (brightness == 0)
+		return FAD_KP_STEP_OFF;
+
+	// First level whose threshold is not below brightness
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+
+		if (brightness <= gpDev->kpThresholds[mid])
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return lo + 1;
+}
+
+/**
+ * Brightness of subjective level
+ *
+ * @return brightness, -EINVAL for unknown level
+ */
+int fad_kp_subj_to_brightness(PFAD_HW_INDEP_INFO gpDev, SUBJ_KEYPAD_BACKL_E subj)
+{
+	switch (subj) {
+	case KP_SUBJ_OFF:
+		return fad_kp_step_to_brightness(gpDev, FAD_KP_STEP_OFF);
+	case KP_SUBJ_LOW:
+		return fad_kp_step_to_brightness(gpDev, 1);
+	case KP_SUBJ_MEDIUM:
+		return fad_kp_step_to_brightness(gpDev, (gpDev->kpNumLevels + 1) / 2);
+	case KP_SUBJ_HIGH:
+		return fad_kp_step_to_brightness(gpDev, gpDev->kpNumLevels);
+	default:
+		return -EINVAL;
+	}
+}
+
+/**
+ * Nearest subjective level of brightness, steps between the first
+ * and last are KP_SUBJ_MEDIUM
+ *
+ * @param gpDev
+ * @param brightness
+ *
+ * @return SUBJ_KEYPAD_BACKL_E
+ */
+SUBJ_KEYPAD_BACKL_E fad_kp_brightness_to_subj(PFAD_HW_INDEP_INFO gpDev, u32 brightness)
+{
+	u32 step = fad_kp_brightness_to_step(gpDev, brightness);
+
+	if (step == FAD_KP_STEP_OFF)
+		return KP_SUBJ_OFF;
+	if (step == 1)
+		return KP_SUBJ_LOW;
+	if (step == (u32)gpDev->kpNumLevels)
+		return KP_SUBJ_HIGH;
+	return KP_SUBJ_MEDIUM;
+}
+
+// Map progress 0..FAD_KP_FADE_ONE through curve
+static int fad_kp_curve(int curve, int p)
+{
+	switch (curve) {
+	case FAD_KP_CURVE_EASE_IN_OUT:
+		// 3p^2 - 2p^3
+		return p * p / FAD_KP_FADE_ONE * (3 * FAD_KP_FADE_ONE - 2 * p) /
+			FAD_KP_FADE_ONE;
+	case FAD_KP_CURVE_PERCEPTUAL:
+		return p * p / FAD_KP_FADE_ONE;
+	case FAD_KP_CURVE_LINEAR:
+	default:
+		return p;
+	}
+}
+
+static void fad_kp_fade_work(struct work_struct *work)
+{
+	struct fad_kp_fade *f = container_of(to_delayed_work(work),
+					     struct fad_kp_fade, work);
+	PFAD_HW_INDEP_INFO gpDev = container_of(f, FAD_HW_INDEP_INFO, kpFade);
+	s64 elapsed = div_s64(ktime_us_delta(ktime_get(), f->start), USEC_PER_MSEC);
+	int p;
+
+	if (!gpDev->pSetKeypadLevel)
+		return;
+	if (elapsed >= f->duration_ms) {
+		gpDev->pSetKeypadLevel(gpDev, f->to);
+		return;
+	}
+
+	p = fad_kp_curve(f->curve, div_u64((u64)elapsed * FAD_KP_FADE_ONE, f->duration_ms));
+	gpDev->pSetKeypadLevel(gpDev, f->from + (f->to - f->from) * p / FAD_KP_FADE_ONE);
+	schedule_delayed_work(&f->work, msecs_to_jiffies(FAD_KP_FADE_TICK_MS));
+}
+
+void fad_kp_init(PFAD_HW_INDEP_INFO gpDev)
+{
+	mutex_init(&gpDev->kpFade.lock);
+	INIT_DELAYED_WORK(&gpDev->kpFade.work, fad_kp_fade_work);
+}
+
+void fad_kp_exit(PFAD_HW_INDEP_INFO gpDev)
+{
+	fad_kp_fade_stop(gpDev);
+}
+
+/**
+ * Stop a running fade, backlight stays at its current level.
+ * Call before setting the keypad backlight directly.
+ *
+ * @param gpDev
+ */
+void fad_kp_fade_stop(PFAD_HW_INDEP_INFO gpDev)
+{
+	mutex_lock(&gpDev->kpFade.lock);
+	cancel_delayed_work_sync(&gpDev->kpFade.work);
+	mutex_unlock(&gpDev->kpFade.lock);
+}
+
+/**
+ * Fade keypad backlight from current level. For platform code only,
+ * no ioctl until a built platform has a keypad backlight backend.
+ *
+ * @param gpDev
+ * @param brightness  Target
+ * @param duration_ms 0 sets target at once
+ * @param curve       enum fad_kp_curve
+ *
+ * @return 0, -EINVAL for unknown curve, -ENODEV without backend
+ */
+int fad_kp_fade(PFAD_HW_INDEP_INFO gpDev, u32 brightness, u32 duration_ms, int curve)
+{
+	struct fad_kp_fade *f = &gpDev->kpFade;
+
+	if (!gpDev->pSetKeypadLevel || !gpDev->pGetKeypadLevel)
+		return -ENODEV;
+	if (curve < FAD_KP_CURVE_LINEAR || curve > FAD_KP_CURVE_PERCEPTUAL)
+		return -EINVAL;
+
+	mutex_lock(&f->lock);
+	cancel_delayed_work_sync(&f->work);
+	f->from = gpDev->pGetKeypadLevel(gpDev);
+	f->to = min_t(u32, brightness, LED_FULL);
+	f->duration_ms = duration_ms;
+	f->curve = curve;
+	f->start = ktime_get();
+	if (duration_ms && f->from != f->to)
+		schedule_delayed_work(&f->work, 0);
+	else
+		gpDev->pSetKeypadLevel(gpDev, f->to);
+	mutex_unlock(&f->lock);
+	return 0;
+}
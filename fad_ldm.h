@@ -0,0 +1,53 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/***********************************************************************
+ *
+ * Project: Balthazar
+ *
+ * Description of file:
+ *    Interface between FAD and a laser distance module driver (CA111).
+ *
+ *    The module driver registers its ops with fad_ldm_register(), FAD
+ *    calls them directly to start and stop measurements, and the module
+ *    driver reports each result with fad_ldm_report().
+ *
+ *  FADDEV Copyright : FLIR Systems AB
+ ***********************************************************************/
+
+#ifndef FAD_LDM_H
+#define FAD_LDM_H
+
+#include <linux/types.h>
+#include <linux/ktime.h>
+
+enum fad_ldm_mode {
+	FAD_LDM_POINTER,	// Laser on, no measurement
+	FAD_LDM_SINGLE,		// One measurement, then laser off
+	FAD_LDM_CONTINUOUS,	// Measure until stopped
+};
+
+enum fad_ldm_accuracy {
+	FAD_LDM_LOW_ACCURACY,
+	FAD_LDM_HIGH_ACCURACY,
+};
+
+struct fad_ldm_result {
+	u32 distance_mm;
+	u32 quality;		// Module specific, higher is better
+	ktime_t timestamp;	// CLOCK_MONOTONIC when measured
+	int status;		// 0, or negative errno when measurement failed
+};
+
+struct fad_ldm_ops {
+	// Start, or change a running measurement to, mode and accuracy
+	int (*start)(void *priv, enum fad_ldm_mode mode, enum fad_ldm_accuracy accuracy);
+	// Stop measurement and turn laser off
+	int (*stop)(void *priv);
+	// >0 laser on, 0 laser off, negative errno on failure
+	int (*get_status)(void *priv);
+};
+
+int fad_ldm_register(const struct fad_ldm_ops *ops, void *priv);
+void fad_ldm_unregister(const struct fad_ldm_ops *ops);
+void fad_ldm_report(const struct fad_ldm_result *result);
+
+#endif /* FAD_LDM_H */
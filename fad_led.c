@@ -0,0 +1,478 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/***********************************************************************
+ *
+ * Project: Balthazar
+ *
+ * Description of file:
+ *    FLIR Application Driver (FAD) LED lookup and KAKA LED pattern engine.
+ *
+ *    LEDs are found through "leds"/"led-names" phandles in DT, so probe
+ *    defers until the LED driver has bound instead of walking the
+ *    global LED list. The KAKA LED is either one multicolor LED, so a
+ *    color change is a single driver transaction, or separate red and
+ *    green LEDs.
+ *
+ *    One hrtimer steps both KAKA LEDs through a sequence of
+ *    (brightness, duration) steps, so the LEDs stay in phase and
+ *    animations need no userspace wakeups. Patterns are uploaded to
+ *    slots once and started by id. The timer only queues a work item
+ *    that writes the LEDs, and each step expires relative to the
+ *    previous one, so a running pattern does not drift.
+ *
+ *  FADDEV Copyright : FLIR Systems AB
+ ***********************************************************************/
+
+#include "flir_kernel_os.h"
+#include "faddev.h"
+#include "fad_internal.h"
+#include <linux/platform_device.h>
+#include <linux/leds.h>
+#include <linux/of.h>
+#include "flir-kernel-version.h"
+
+#if IS_ENABLED(CONFIG_LEDS_CLASS_MULTICOLOR) && KERNEL_VERSION(5, 9, 0) <= LINUX_VERSION_CODE
+#include <linux/led-class-multicolor.h>
+#define FAD_LED_MC
+#endif
+
+/**
+ * Get LED by DT phandle, the "leds" entry named con_id in "led-names".
+ * Kernels without of_led_get() fall back to matching the LED class name.
+ *
+ * @param dev
+ * @param con_id  Name in "led-names"
+ * @param legacy  LED class name, used on old kernels only
+ * @param led     Result, NULL if the LED is not described
+ *
+ * @return 0, -EPROBE_DEFER while the LED driver has not bound
+ */
+int fad_led_get(struct device *dev, const char *con_id, const char *legacy,
+		struct led_classdev **led)
+{
+#if defined(CONFIG_OF) && KERNEL_VERSION(5, 5, 0) <= LINUX_VERSION_CODE
+	struct led_classdev *cdev;
+	int index;
+
+	*led = NULL;
+	index = of_property_match_string(dev->of_node, "led-names", con_id);
+	if (index < 0) {
+		dev_warn(dev, "No '%s' in led-names\n", con_id);
+		return 0;
+	}
+
+	cdev = devm_of_led_get(dev, index);
+	if (IS_ERR(cdev)) {
+		if (PTR_ERR(cdev) == -EPROBE_DEFER)
+			return -EPROBE_DEFER;
+		dev_err(dev, "Failed to get LED '%s': %ld\n", con_id, PTR_ERR(cdev));
+		return 0;
+	}
+	*led = cdev;
+	return 0;
+#else
+	extern struct list_head leds_list;
+	extern struct rw_semaphore leds_list_lock;
+	struct led_classdev *cdev;
+
+	*led = NULL;
+	if (!legacy)
+		return 0;
+	down_read(&leds_list_lock);
+	// Match the device name, it may differ from the classdev name
+	list_for_each_entry(cdev, &leds_list, node) {
+		if (cdev->dev && cdev->dev->kobj.name &&
+		    strcmp(cdev->dev->kobj.name, legacy) == 0) {
+			*led = cdev;
+			break;
+		}
+	}
+	up_read(&leds_list_lock);
+	if (!*led)
+		dev_warn(dev, "LED '%s' not found\n", legacy);
+	return 0;
+#endif
+}
+
+/**
+ * Get the KAKA LED, a multicolor LED named "kaka" with red and green
+ * channels, else separate LEDs "kaka-red" and "kaka-green".
+ *
+ * @param gpDev
+ * @param dev
+ * @param red_legacy   LED class names used on old kernels
+ * @param green_legacy
+ *
+ * @return 0, -EPROBE_DEFER while the LED driver has not bound
+ */
+int fad_led_get_kaka(PFAD_HW_INDEP_INFO gpDev, struct device *dev,
+		     const char *red_legacy, const char *green_legacy)
+{
+	int retval;
+#ifdef FAD_LED_MC
+	struct led_classdev *cdev;
+
+	if (of_property_match_string(dev->of_node, "led-names", "kaka") >= 0) {
+		retval = fad_led_get(dev, "kaka", NULL, &cdev);
+		if (retval || !cdev)
+			return retval;
+		if (cdev->flags & LED_MULTI_COLOR) {
+			struct led_classdev_mc *mc = lcdev_to_mccdev(cdev);
+			int i;
+
+			gpDev->kaka_mc_red = -1;
+			gpDev->kaka_mc_green = -1;
+			for (i = 0; i < mc->num_colors; i++) {
+				if (mc->subled_info[i].color_index == LED_COLOR_ID_RED)
+					gpDev->kaka_mc_red = i;
+				else if (mc->subled_info[i].color_index == LED_COLOR_ID_GREEN)
+					gpDev->kaka_mc_green = i;
+			}
+			if (gpDev->kaka_mc_red >= 0 && gpDev->kaka_mc_green >= 0) {
+				gpDev->kaka_mc = mc;
+				return 0;
+			}
+		}
+		dev_err(dev, "LED 'kaka' is not a red/green multicolor LED\n");
+	}
+#endif
+	retval = fad_led_get(dev, "kaka-red", red_legacy, &gpDev->red_led_cdev);
+	if (!retval)
+		retval = fad_led_get(dev, "kaka-green", green_legacy, &gpDev->blue_led_cdev);
+	return retval;
+}
+
+/**
+ * LED class device of a multicolor KAKA LED
+ *
+ * @return NULL if KAKA is separate LEDs
+ */
+struct led_classdev *fad_led_kaka_cdev(PFAD_HW_INDEP_INFO gpDev)
+{
+#ifdef FAD_LED_MC
+	if (gpDev->kaka_mc)
+		return &gpDev->kaka_mc->led_cdev;
+#endif
+	return NULL;
+}
+
+BOOL fad_led_has_kaka(PFAD_HW_INDEP_INFO gpDev, BOOL *red, BOOL *green)
+{
+	*red = gpDev->red_led_cdev || fad_led_kaka_cdev(gpDev);
+	*green = gpDev->blue_led_cdev || fad_led_kaka_cdev(gpDev);
+	return *red || *green;
+}
+
+// Called with engine lock held
+static void fad_led_write(PFAD_HW_INDEP_INFO gpDev, u8 red, u8 green)
+{
+	struct fad_led_engine *e = &gpDev->ledEngine;
+
+#ifdef FAD_LED_MC
+	if (gpDev->kaka_mc) {
+		struct led_classdev_mc *mc = gpDev->kaka_mc;
+		unsigned int max = mc->led_cdev.max_brightness;
+
+		// Both channels in one brightness_set
+		mc->subled_info[gpDev->kaka_mc_red].intensity = red * max / LED_FULL;
+		mc->subled_info[gpDev->kaka_mc_green].intensity = green * max / LED_FULL;
+		led_set_brightness(&mc->led_cdev, (red || green) ? max : LED_OFF);
+		e->red = red;
+		e->green = green;
+		return;
+	}
+#endif
+	if (gpDev->red_led_cdev)
+		led_set_brightness(gpDev->red_led_cdev, red);
+	if (gpDev->blue_led_cdev)
+		led_set_brightness(gpDev->blue_led_cdev, green);
+	e->red = red;
+	e->green = green;
+}
+
+static void fad_led_apply(PFAD_HW_INDEP_INFO gpDev, const FADDEVLEDSTEP *step)
+{
+	fad_led_write(gpDev, step->ucRed, step->ucBlue);
+}
+
+/**
+ * Set KAKA LED levels, call with pattern engine stopped
+ *
+ * @param gpDev
+ * @param red    Brightness 0-255
+ * @param green  Brightness 0-255, blue_led_cdev when separate LEDs
+ */
+void fad_led_set_kaka(PFAD_HW_INDEP_INFO gpDev, u8 red, u8 green)
+{
+	struct fad_led_engine *e = &gpDev->ledEngine;
+	BOOL hasRed, hasGreen;
+
+	mutex_lock(&e->lock);
+	fad_led_write(gpDev, red, green);
+	mutex_unlock(&e->lock);
+
+	fad_led_has_kaka(gpDev, &hasRed, &hasGreen);
+	fad_load_set(gpDev, FAD_LOAD_RED_LED, hasRed && red);
+	fad_load_set(gpDev, FAD_LOAD_BLUE_LED, hasGreen && green);
+}
+
+/**
+ * Last written KAKA LED levels
+ *
+ * @param gpDev
+ * @param red
+ * @param green
+ */
+void fad_led_kaka_levels(PFAD_HW_INDEP_INFO gpDev, u8 *red, u8 *green)
+{
+	struct fad_led_engine *e = &gpDev->ledEngine;
+
+	mutex_lock(&e->lock);
+	*red = e->red;
+	*green = e->green;
+	mutex_unlock(&e->lock);
+}
+
+static enum hrtimer_restart fad_led_timer(struct hrtimer *timer)
+{
+	struct fad_led_engine *e = container_of(timer, struct fad_led_engine, timer);
+
+	schedule_work(&e->work);
+	return HRTIMER_NORESTART;
+}
+
+// Called with engine lock held
+static void fad_led_arm(struct fad_led_engine *e, const FADDEVLEDSTEP *step)
+{
+	e->next = ktime_add(e->next, ms_to_ktime(step->usTimeMs));
+	hrtimer_start(&e->timer, e->next, HRTIMER_MODE_ABS);
+}
+
+static void fad_led_work(struct work_struct *work)
+{
+	struct fad_led_engine *e = container_of(work, struct fad_led_engine, work);
+	PFAD_HW_INDEP_INFO gpDev = container_of(e, FAD_HW_INDEP_INFO, ledEngine);
+	const FADDEVLEDSTEP *step;
+
+	mutex_lock(&e->lock);
+	if (!e->bRunning)
+		goto out;
+
+	if (++e->step >= e->cur.steps) {
+		e->step = 0;
+		if (e->cur.repeat && ++e->loops >= e->cur.repeat) {
+			// Finite pattern done, LEDs keep last step
+			e->bRunning = FALSE;
+			goto out;
+		}
+	}
+	step = &e->cur.step[e->step];
+	fad_led_apply(gpDev, step);
+	fad_led_arm(e, step);
+out:
+	mutex_unlock(&e->lock);
+}
+
+// Stop LED core software blink, it would fight the engine
+static void fad_led_stop_blink(struct led_classdev *led)
+{
+	if (!led)
+		return;
+	led_set_brightness(led, LED_OFF);
+#if KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE
+	flush_work(&led->set_brightness_work);
+#endif
+}
+
+void fad_led_init(PFAD_HW_INDEP_INFO gpDev)
+{
+	struct fad_led_engine *e = &gpDev->ledEngine;
+
+	mutex_init(&e->lock);
+	hrtimer_init(&e->timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	e->timer.function = fad_led_timer;
+	INIT_WORK(&e->work, fad_led_work);
+}
+
+void fad_led_exit(PFAD_HW_INDEP_INFO gpDev)
+{
+	fad_led_stop(gpDev);
+}
+
+/**
+ * Stop running pattern, LEDs keep current state
+ *
+ * @param gpDev
+ */
+void fad_led_stop(PFAD_HW_INDEP_INFO gpDev)
+{
+	struct fad_led_engine *e = &gpDev->ledEngine;
+
+	mutex_lock(&e->lock);
+	e->bRunning = FALSE;
+	e->flashState = 0;
+	mutex_unlock(&e->lock);
+	// Work does not re-arm the timer once stopped
+	hrtimer_cancel(&e->timer);
+	cancel_work_sync(&e->work);
+}
+
+/**
+ * Start pattern from its first step
+ *
+ * @param gpDev
+ * @param pattern    Copied, caller's copy may change afterwards
+ * @param flashState LED_FLASH_xxx reported by getLedState(), 0 for none
+ */
+void fad_led_start(PFAD_HW_INDEP_INFO gpDev, const struct fad_led_pattern *pattern,
+		   int flashState)
+{
+	struct fad_led_engine *e = &gpDev->ledEngine;
+	BOOL red, blue, hasRed, hasBlue;
+	u32 i;
+
+	fad_led_stop(gpDev);
+	fad_led_stop_blink(gpDev->red_led_cdev);
+	fad_led_stop_blink(gpDev->blue_led_cdev);
+	fad_led_stop_blink(fad_led_kaka_cdev(gpDev));
+
+	mutex_lock(&e->lock);
+	e->cur = *pattern;
+	e->step = 0;
+	e->loops = 0;
+	e->bRunning = TRUE;
+	e->flashState = flashState;
+	fad_led_apply(gpDev, &e->cur.step[0]);
+	e->next = ktime_get();
+	fad_led_arm(e, &e->cur.step[0]);
+	mutex_unlock(&e->lock);
+
+	fad_led_has_kaka(gpDev, &hasRed, &hasBlue);
+	red = blue = FALSE;
+	for (i = 0; i < pattern->steps; i++) {
+		red |= pattern->step[i].ucRed != 0;
+		blue |= pattern->step[i].ucBlue != 0;
+	}
+	fad_load_set(gpDev, FAD_LOAD_RED_LED, red && hasRed);
+	fad_load_set(gpDev, FAD_LOAD_BLUE_LED, blue && hasBlue);
+}
+
+/**
+ * Upload pattern to a slot, for IOCTL_FAD_SET_LED_PATTERN
+ *
+ * @return 0, -EINVAL for bad id or steps
+ */
+int fad_led_set_pattern(PFAD_HW_INDEP_INFO gpDev, const FADDEVIOCTLLEDPATTERN *pPattern)
+{
+	struct fad_led_engine *e = &gpDev->ledEngine;
+	struct fad_led_pattern *p;
+	u32 i;
+
+	if (pPattern->ulId >= FAD_LED_MAX_PATTERNS ||
+	    pPattern->ulSteps < 1 || pPattern->ulSteps > FAD_LED_MAX_STEPS)
+		return -EINVAL;
+	for (i = 0; i < pPattern->ulSteps; i++)
+		if (!pPattern->step[i].usTimeMs)
+			return -EINVAL;
+
+	mutex_lock(&e->lock);
+	p = &e->patterns[pPattern->ulId];
+	p->repeat = pPattern->ulRepeat;
+	p->steps = pPattern->ulSteps;
+	memcpy(p->step, pPattern->step, sizeof(p->step[0]) * p->steps);
+	mutex_unlock(&e->lock);
+	return 0;
+}
+
+/**
+ * Start uploaded pattern, for IOCTL_FAD_START_LED_PATTERN
+ *
+ * @param id  Slot, or FAD_LED_PATTERN_STOP
+ *
+ * @return 0, -EINVAL for bad or empty slot
+ */
+int fad_led_start_id(PFAD_HW_INDEP_INFO gpDev, u32 id)
+{
+	struct fad_led_engine *e = &gpDev->ledEngine;
+	struct fad_led_pattern pattern;
+
+	if (id == FAD_LED_PATTERN_STOP) {
+		fad_led_stop(gpDev);
+		fad_led_set_kaka(gpDev, LED_OFF, LED_OFF);
+		return 0;
+	}
+	if (id >= FAD_LED_MAX_PATTERNS)
+		return -EINVAL;
+
+	mutex_lock(&e->lock);
+	pattern = e->patterns[id];
+	mutex_unlock(&e->lock);
+	if (!pattern.steps)
+		return -EINVAL;
+
+	fad_led_start(gpDev, &pattern, 0);
+	return 0;
+}
+
+/**
+ * Copy running pattern, to restart it later with fad_led_start()
+ *
+ * @return TRUE if a pattern is running
+ */
+BOOL fad_led_running(PFAD_HW_INDEP_INFO gpDev, struct fad_led_pattern *pattern,
+		     int *flashState)
+{
+	struct fad_led_engine *e = &gpDev->ledEngine;
+	BOOL running;
+
+	mutex_lock(&e->lock);
+	running = e->bRunning;
+	if (running) {
+		*pattern = e->cur;
+		*flashState = e->flashState;
+	}
+	mutex_unlock(&e->lock);
+	return running;
+}
+
+/**
+ * Legacy flash state of the running pattern, read together with
+ * bRunning under the engine lock
+ *
+ * @param gpDev
+ *
+ * @return LED_FLASH_xxx state, 0 if no pattern runs
+ */
+int fad_led_flash_state(PFAD_HW_INDEP_INFO gpDev)
+{
+	struct fad_led_engine *e = &gpDev->ledEngine;
+	int state;
+
+	mutex_lock(&e->lock);
+	state = e->bRunning ? e->flashState : 0;
+	mutex_unlock(&e->lock);
+	return state;
+}
+
+/**
+ * KAKA LEDs lit by a running pattern or by the last levels set
+ *
+ * @param gpDev
+ * @param red
+ * @param blue
+ */
+void fad_led_in_use(PFAD_HW_INDEP_INFO gpDev, BOOL *red, BOOL *blue)
+{
+	struct fad_led_engine *e = &gpDev->ledEngine;
+	u32 i;
+
+	mutex_lock(&e->lock);
+	*red = e->red != 0;
+	*blue = e->green != 0;
+	if (e->bRunning) {
+		for (i = 0; i < e->cur.steps; i++) {
+			*red |= e->cur.step[i].ucRed != 0;
+			*blue |= e->cur.step[i].ucBlue != 0;
+		}
+	}
+	mutex_unlock(&e->lock);
+}
@@ -41,8 +41,6 @@ static BOOL setGPSEnable(BOOL on);
 static BOOL getGPSEnable(BOOL *on);
 static void WdogInit(PFAD_HW_INDEP_INFO gpDev, UINT32 Timeout);
 static BOOL WdogService(PFAD_HW_INDEP_INFO gpDev);
-static void BspGetSubjBackLightLevel(UINT8 *pLow, UINT8 *pMedium,
-				     UINT8 *pHigh);
 static void CleanupHW(PFAD_HW_INDEP_INFO gpDev);
 static irqreturn_t fadDigIN1IST(int irq, void *dev_id);
 int InitDigitalIOIrq(PFAD_HW_INDEP_INFO gpDev);
@@ -52,9 +50,7 @@ int InitDigitalIOIrq(PFAD_HW_INDEP_INFO gpDev);
 int SetupMX6S(PFAD_HW_INDEP_INFO gpDev)
 {
 	int retval;
-	extern struct list_head leds_list;
-	extern struct rw_semaphore leds_list_lock;
-	struct led_classdev *led_cdev;
+	struct faddata *data = container_of(gpDev, struct faddata, pDev);
 
 	gpDev->pGetKAKALedState = getKAKALedState;
 	gpDev->pSetKAKALedState = setKAKALedState;
@@ -97,19 +93,15 @@ int SetupMX6S(PFAD_HW_INDEP_INFO gpDev)
 //        DDKIomuxSetPadConfig(FLIR_IOMUX_PAD_PWM_BUZZER);
 	}
 
-	BspGetSubjBackLightLevel(&gpDev->Keypad_bl_low,
-				 &gpDev->Keypad_bl_medium,
-				 &gpDev->Keypad_bl_high);
+	fad_kp_levels_init(gpDev);
 
 	// Find LEDs
-	down_read(&leds_list_lock);
-	list_for_each_entry(led_cdev, &leds_list, node) {
-		if (strcmp(led_cdev->name, "red_led") == 0)
-			gpDev->red_led_cdev = led_cdev;
-		else if (strcmp(led_cdev->name, "blue_led") == 0)
-			gpDev->blue_led_cdev = led_cdev;
-	}
-	up_read(&leds_list_lock);
+	retval = fad_led_get(data->dev, "red", "red_led", &gpDev->red_led_cdev);
+	if (!retval)
+		retval = fad_led_get(data->dev, "blue", "blue_led",
+				     &gpDev->blue_led_cdev);
+	if (retval)
+		return retval;
 
 	pr_debug("I2C drivers %p and %p\n", gpDev->hI2C1, gpDev->hI2C2);
 
@@ -494,13 +486,6 @@ void BspFadPowerDown(BOOL down)
 }
 #endif
 
-void BspGetSubjBackLightLevel(UINT8 *pLow, UINT8 *pMedium, UINT8 *pHigh)
-{
-	*pLow = 10;
-	*pMedium = 40;
-	*pHigh = 75;
-}
-
 irqreturn_t fadDigIN1IST(int irq, void *dev_id)
 {
 	PFAD_HW_INDEP_INFO gpDev = (PFAD_HW_INDEP_INFO) dev_id;
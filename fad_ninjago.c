@@ -32,6 +32,13 @@
 #define ENOLASERIRQ 1
 #define ENODIGIOIRQ 2
 // Local variables
+#ifdef CONFIG_OF
+static const char * const focus_supply_names[FAD_FOCUS_SUPPLIES] = {
+	[FAD_SUPPLY_OPTICS] = "optics_power",
+	[FAD_SUPPLY_POSITION_SENSOR] = "position_sensor",
+	[FAD_SUPPLY_RING_SENSOR] = "ring_sensor",
+};
+#endif
 
 // Function prototypes
 
@@ -48,8 +55,14 @@ static BOOL getGPSEnable(BOOL *on);
 
 static int suspend(PFAD_HW_INDEP_INFO gpDev);
 static int resume(PFAD_HW_INDEP_INFO gpDev);
+static int runtime_suspend(PFAD_HW_INDEP_INFO gpDev);
+static int runtime_resume(PFAD_HW_INDEP_INFO gpDev);
 static int SetChargerSuspend(PFAD_HW_INDEP_INFO gpDev, BOOL suspend);
-static int SetMotorSleepRegulator(PFAD_HW_INDEP_INFO gpDev, BOOL suspend);
+static int SetFocusMotor(PFAD_HW_INDEP_INFO gpDev, BOOL on);
+static int SetChargeProfile(PFAD_HW_INDEP_INFO gpDev, BOOL charge);
+#ifdef CONFIG_OF
+static void ReadChargeProfile(PFAD_HW_INDEP_INFO gpDev, struct device *dev);
+#endif
 
 // Code
 int SetupMX6Platform(PFAD_HW_INDEP_INFO gpDev)
@@ -57,9 +70,6 @@ int SetupMX6Platform(PFAD_HW_INDEP_INFO gpDev)
 	int retval = 0;
 
 #ifdef CONFIG_OF
-	extern struct list_head leds_list;
-	extern struct rw_semaphore leds_list_lock;
-	struct led_classdev *led_cdev;
 	struct faddata *data = container_of(gpDev, struct faddata, pDev);
 	struct device *dev = data->dev;
 #endif
@@ -72,8 +82,12 @@ int SetupMX6Platform(PFAD_HW_INDEP_INFO gpDev)
 	gpDev->pSetGPSEnable = setGPSEnable;
 	gpDev->pGetGPSEnable = getGPSEnable;
 	gpDev->pSetChargerSuspend = SetChargerSuspend;
+	gpDev->pSetFocusMotor = SetFocusMotor;
+	gpDev->pSetChargeProfile = SetChargeProfile;
 	gpDev->suspend = suspend;
 	gpDev->resume = resume;
+	gpDev->runtime_suspend = runtime_suspend;
+	gpDev->runtime_resume = runtime_resume;
 
 #ifdef CONFIG_OF
 	/* Configure devices (bools) from DT */
@@ -87,6 +101,13 @@ int SetupMX6Platform(PFAD_HW_INDEP_INFO gpDev)
 	of_property_read_u32_index(dev->of_node, "HasKAKALed", 0,&gpDev->bHasKAKALed);
 	of_property_read_u32_index(dev->of_node, "hasFocusModule", 0, &gpDev->bHasFocusModule);
 
+	// Find LEDs first, nothing to undo if their driver has not bound yet
+	if (gpDev->bHasKAKALed) {
+		retval = fad_led_get_kaka(gpDev, dev, "KAKA_LED2", "KAKA_LED1");
+		if (retval)
+			return retval;
+	}
+
 	// Determine what laser device to use
 	if (gpDev->bHasLaser) {
 		if (of_machine_is_compatible("fsl,imx6qp-eoco")){
@@ -96,59 +117,49 @@ int SetupMX6Platform(PFAD_HW_INDEP_INFO gpDev)
 		}
 	}
 
-	// Find regulators related to focusing.
+	// Find regulators related to focusing, each one optional
 	if (gpDev->bHasFocusModule) {
-
-		gpDev->reg_optics_power = devm_regulator_get(dev, "optics_power");
-		if (IS_ERR(gpDev->reg_optics_power))
-			dev_err(dev, "can't get regulator optics_power");
-		else
-			retval |= regulator_enable(gpDev->reg_optics_power);
-
-		gpDev->reg_position_sensor = devm_regulator_get(dev, "position_sensor");
-		if (IS_ERR(gpDev->reg_position_sensor))
-			dev_err(dev, "can't get regulator position_sensor");
-		else
-			retval |= regulator_enable(gpDev->reg_position_sensor);
-
-		gpDev->reg_ring_sensor = devm_regulator_get(dev, "ring_sensor");
-		if (IS_ERR(gpDev->reg_ring_sensor))
-			dev_err(dev, "can't get regulator ring_sensor");
-		else
-			retval |= regulator_enable(gpDev->reg_ring_sensor);
-
-		gpDev->reg_motor_sleep = devm_regulator_get(dev, "motor_sleep");
-		if (IS_ERR(gpDev->reg_motor_sleep))
-			dev_err(dev, "can't get regulator motor_sleep");
-		else
-			retval |= SetMotorSleepRegulator(gpDev, true);
-	}
-
-	gpDev->backlight = of_find_backlight_by_node(of_parse_phandle(dev->of_node, "backlight", 0));
-
-	// Find LEDs
-	if (gpDev->bHasKAKALed) {
-		down_read(&leds_list_lock);
-		list_for_each_entry(led_cdev, &leds_list, node) {
-
-			if (!led_cdev->dev) {
-				dev_err(dev, "finding KAKA leds - dev is NULL");
-				continue;
-			}
-
-			if (!led_cdev->dev->kobj.name) {
-				dev_err(dev, "finding KAKA leds - listed led name is NULL");
+		struct regulator *reg;
+		int i, n = 0;
+
+		gpDev->bMotorLazyResume = of_property_read_bool(dev->of_node,
+								"motor-lazy-resume");
+		gpDev->pdOffDelayMs = FAD_PD_OFF_DELAY_MS;
+		of_property_read_u32(dev->of_node, "power-off-delay-ms",
+				     &gpDev->pdOffDelayMs);
+
+		for (i = 0; i < FAD_FOCUS_SUPPLIES; i++) {
+			reg = devm_regulator_get_optional(dev, focus_supply_names[i]);
+			if (IS_ERR(reg)) {
+				dev_err(dev, "can't get regulator %s", focus_supply_names[i]);
 				continue;
 			}
+			gpDev->focus_supplies[n].supply = focus_supply_names[i];
+			gpDev->focus_supplies[n++].consumer = reg;
+		}
+		if (n) {
+			gpDev->bHasFocusSupplies = TRUE;
+			fad_pd_init(gpDev, &gpDev->pdFocus, "focus",
+				    gpDev->focus_supplies, n, FAD_LOAD_OPTICS);
+			// Device starts runtime active, see fad_probe()
+			retval |= fad_pd_get(&gpDev->pdFocus, FAD_PD_RUNTIME);
+		}
 
-			if (strcmp(led_cdev->dev->kobj.name, "KAKA_LED2") == 0)
-				gpDev->red_led_cdev = led_cdev;
-			else if (strcmp(led_cdev->dev->kobj.name, "KAKA_LED1") == 0)
-				gpDev->blue_led_cdev = led_cdev;
+		reg = devm_regulator_get_optional(dev, "motor_sleep");
+		if (IS_ERR(reg)) {
+			dev_err(dev, "can't get regulator motor_sleep");
+		} else {
+			gpDev->motor_supply.supply = "motor_sleep";
+			gpDev->motor_supply.consumer = reg;
+			gpDev->bHasMotorSupply = TRUE;
+			fad_pd_init(gpDev, &gpDev->pdMotor, "motor",
+				    &gpDev->motor_supply, 1, FAD_LOAD_MOTOR);
+			retval |= fad_pd_get(&gpDev->pdMotor, FAD_PD_RUN);
 		}
-		up_read(&leds_list_lock);
 	}
 
+	gpDev->backlight = of_find_backlight_by_node(of_parse_phandle(dev->of_node, "backlight", 0));
+
 	if (gpDev->bHasDigitalIO) {
 		int pin;
 
@@ -179,13 +190,27 @@ int SetupMX6Platform(PFAD_HW_INDEP_INFO gpDev)
 			gpDev->trigger_gpio = pin;
 			gpio_request(pin, "Trigger");
 			gpio_direction_input(pin);
-			if (request_irq(gpio_to_irq(pin), fadTriggerIST, IRQF_TRIGGER_FALLING, "TriggerGPIO", gpDev))
-				pr_err("flridrv-fad: Failed to register interrupt for trigger...\n");
-			else
-				pr_debug("flirdrv-fad: Registered interrupt %i for trigger\n", gpio_to_irq(pin));
+
+			gpDev->trigger.long_press_ms = 800;
+			gpDev->trigger.double_press_ms = 300;
+			of_property_read_u32(dev->of_node, "trigger-long-press-ms",
+					     &gpDev->trigger.long_press_ms);
+			of_property_read_u32(dev->of_node, "trigger-double-press-ms",
+					     &gpDev->trigger.double_press_ms);
+			gpDev->bTriggerWakeup = of_property_read_bool(dev->of_node,
+								      "trigger-wakeup");
+			retval = InitTriggerIrq(gpDev);
+			if (retval) {
+				pr_err("flirdrv-fad: Trigger irq setup failed (%d)\n", retval);
+				gpio_free(pin);
+				gpDev->trigger_gpio = 0;
+				InvSetupMX6Platform(gpDev);
+				return retval;
+			}
 		}
 	}
 
+	ReadChargeProfile(gpDev, dev);
 #endif
 	return retval;
 }
@@ -200,18 +225,18 @@ void InvSetupMX6Platform(PFAD_HW_INDEP_INFO gpDev)
 	if (gpDev->bHasLaser) {
 		if (of_machine_is_compatible("fsl,imx6qp-eoco")){
 			InvSetupLaserPointer(gpDev);
+		} else {
+			InvSetupLaserDistance(gpDev);
 		}
 	}
 
 	if (gpDev->trigger_gpio)
-		free_irq(gpio_to_irq(gpDev->trigger_gpio), gpDev);
+		FreeTriggerIrq(gpDev);
 
-	if (gpDev->bHasFocusModule) {
-		SetMotorSleepRegulator(gpDev, false);
-		regulator_disable(gpDev->reg_ring_sensor);
-		regulator_disable(gpDev->reg_position_sensor);
-		regulator_disable(gpDev->reg_optics_power);
-	}
+	if (gpDev->bHasMotorSupply)
+		fad_pd_exit(&gpDev->pdMotor);
+	if (gpDev->bHasFocusSupplies)
+		fad_pd_exit(&gpDev->pdFocus);
 
 	if (gpDev->digin0_gpio)
 		gpio_free(gpDev->digin0_gpio);
@@ -224,28 +249,22 @@ DWORD getLedState(PFAD_HW_INDEP_INFO gpDev, FADDEVIOCTLLED *pLED)
 #ifdef CONFIG_OF
 	BOOL redLed = FALSE;
 	BOOL blueLed = FALSE;
+	int flashState;
 
-	if (!gpDev->red_led_cdev || !gpDev->blue_led_cdev) {
+	if (!fad_led_has_kaka(gpDev, &redLed, &blueLed)) {
 		pLED->eState = LED_STATE_OFF;
 		return ERROR_SUCCESS;
 	}
 
-	if (gpDev->red_led_cdev->brightness)
-		redLed = TRUE;
-	if (gpDev->blue_led_cdev->brightness)
-		blueLed = TRUE;
-
-	if (gpDev->red_led_cdev->blink_delay_on == 500 ||
-	    gpDev->blue_led_cdev->blink_delay_on == 500)
-		pLED->eState = LED_FLASH_SLOW;
-	else if (gpDev->red_led_cdev->blink_delay_on == 100 ||
-		 gpDev->blue_led_cdev->blink_delay_on == 100)
-		pLED->eState = LED_FLASH_FAST;
-	else if ((blueLed == FALSE) && (redLed == FALSE)) {
+	// Report what was set, not what the LED class happens to show
+	fad_led_in_use(gpDev, &redLed, &blueLed);
+	flashState = fad_led_flash_state(gpDev);
+	if (flashState)
+		pLED->eState = flashState;
+	else if ((blueLed == FALSE) && (redLed == FALSE))
 		pLED->eState = LED_STATE_OFF;
-	} else {
+	else
 		pLED->eState = LED_STATE_ON;
-	}
 #endif
 	return ERROR_SUCCESS;
 }
@@ -255,47 +274,28 @@ DWORD setLedState(PFAD_HW_INDEP_INFO gpDev, FADDEVIOCTLLED *pLED)
 #ifdef CONFIG_OF
 	BOOL redLed = FALSE;
 	BOOL greenLed = FALSE;
-	unsigned long delay = 0;
+	struct fad_led_pattern flash = { .repeat = 0, .steps = 2 };
 
 	// On Bellatrix the KAKA LED consists of a green and a red LED
 	// The blue_led_cdev actually controls a green LED
-	if (gpDev->red_led_cdev
-	    && (gpDev->red_led_cdev->brightness
-		|| gpDev->red_led_cdev->blink_delay_on))
-		redLed = TRUE;
-	if (gpDev->blue_led_cdev
-	    && (gpDev->blue_led_cdev->brightness
-		|| gpDev->blue_led_cdev->blink_delay_on))
-		greenLed = TRUE;
+	fad_led_in_use(gpDev, &redLed, &greenLed);
 
 	if (pLED->eState == LED_FLASH_SLOW || pLED->eState == LED_FLASH_FAST) {
-		if (pLED->eState == LED_FLASH_FAST)
-			delay = 100;
-		else
-			delay = 500;
-
-		if (redLed) {
-			led_blink_set(gpDev->red_led_cdev, &delay, &delay);
-		}
-
-		if (greenLed) {
-			led_blink_set(gpDev->blue_led_cdev, &delay, &delay);
-		}
-	} else if (pLED->eState == LED_STATE_ON) {
-		if (gpDev->blue_led_cdev) {
-			led_set_brightness(gpDev->blue_led_cdev, LED_FULL);
-		}
-		if (gpDev->red_led_cdev) {
-			led_set_brightness(gpDev->red_led_cdev, LED_OFF);
-		}
-	} else if (pLED->eState == LED_STATE_OFF) {
-		if (gpDev->blue_led_cdev) {
-			led_set_brightness(gpDev->blue_led_cdev, LED_OFF);
-		}
-		if (gpDev->red_led_cdev) {
-			led_set_brightness(gpDev->red_led_cdev, LED_OFF);
-		}
+		// Flash the lit LEDs in phase
+		flash.step[0].ucRed = redLed ? LED_FULL : LED_OFF;
+		flash.step[0].ucBlue = greenLed ? LED_FULL : LED_OFF;
+		flash.step[0].usTimeMs = pLED->eState == LED_FLASH_FAST ? 100 : 500;
+		flash.step[1].usTimeMs = flash.step[0].usTimeMs;
+		if (redLed || greenLed)
+			fad_led_start(gpDev, &flash, pLED->eState);
+		return ERROR_SUCCESS;
 	}
+
+	fad_led_stop(gpDev);
+	if (pLED->eState == LED_STATE_ON)
+		fad_led_set_kaka(gpDev, LED_OFF, LED_FULL);
+	else if (pLED->eState == LED_STATE_OFF)
+		fad_led_set_kaka(gpDev, LED_OFF, LED_OFF);
 #endif
 	return ERROR_SUCCESS;
 }
@@ -307,14 +307,7 @@ DWORD getKAKALedState(PFAD_HW_INDEP_INFO gpDev, FADDEVIOCTLLED *pLED)
 
 	// On Bellatrix the KAKA LED consists of a green and a red LED
 	// The blue_led_cdev actually controls a green LED
-	if (gpDev->red_led_cdev
-	    && (gpDev->red_led_cdev->brightness
-		|| gpDev->red_led_cdev->blink_delay_on))
-		redLed = TRUE;
-	if (gpDev->blue_led_cdev
-	    && (gpDev->blue_led_cdev->brightness
-		|| gpDev->blue_led_cdev->blink_delay_on))
-		greenLed = TRUE;
+	fad_led_in_use(gpDev, &redLed, &greenLed);
 
 	if ((greenLed == FALSE) && (redLed == FALSE)) {
 		pLED->eState = LED_STATE_OFF;
@@ -351,15 +344,9 @@ DWORD setKAKALedState(PFAD_HW_INDEP_INFO gpDev, FADDEVIOCTLLED *pLED)
 		}
 	}
 
-	if (gpDev->red_led_cdev) {
-		led_set_brightness(gpDev->red_led_cdev,
-				   redLed ? LED_FULL : LED_OFF);
-	}
-
-	if (gpDev->blue_led_cdev) {
-		led_set_brightness(gpDev->blue_led_cdev,
-				   greenLed ? LED_FULL : LED_OFF);
-	}
+	fad_led_stop(gpDev);
+	fad_led_set_kaka(gpDev, redLed ? LED_FULL : LED_OFF,
+			 greenLed ? LED_FULL : LED_OFF);
 #endif
 	return ERROR_SUCCESS;
 }
@@ -399,26 +386,16 @@ int suspend(PFAD_HW_INDEP_INFO gpDev)
 		int res = 0;
 
 		pr_debug("Disbling motor regulator...\n");
-		res = SetMotorSleepRegulator(gpDev, false);
-		if (res)
-			pr_err("Motor regulator disable failed..\n");
-		pr_debug("Disbling ring sensor...\n");
-		if (gpDev->reg_ring_sensor) {
-			res = regulator_disable(gpDev->reg_ring_sensor);
+		if (gpDev->bHasMotorSupply) {
+			res = fad_pd_suspend(&gpDev->pdMotor);
 			if (res)
-				pr_err("Ring sensor disable failed..\n");
+				pr_err("Motor regulator disable failed..\n");
 		}
-		pr_debug("Disbling position sensor...\n");
-		if (gpDev->reg_position_sensor) {
-			res |= regulator_disable(gpDev->reg_position_sensor);
+		pr_debug("Disbling focus sensors and optics power...\n");
+		if (gpDev->bHasFocusSupplies) {
+			res = fad_pd_suspend(&gpDev->pdFocus);
 			if (res)
-				pr_err("Position sensor disable failed..\n");
-		}
-		pr_debug("Disbling optics power...\n");
-		if (gpDev->reg_optics_power) {
-			res |= regulator_disable(gpDev->reg_optics_power);
-			if (res)
-				pr_err("Optics power disable failed..\n");
+				pr_err("Focus regulators disable failed..\n");
 		}
 	}
 #endif
@@ -431,17 +408,47 @@ int resume(PFAD_HW_INDEP_INFO gpDev)
 
 #ifdef CONFIG_OF
 	if (gpDev->bHasFocusModule) {
-		res = regulator_enable(gpDev->reg_optics_power);
-		res |= regulator_enable(gpDev->reg_position_sensor);
-		res |= regulator_enable(gpDev->reg_ring_sensor);
-		res |= SetMotorSleepRegulator(gpDev, true);
+		// Ramp optics and sensor rails in parallel
+		if (gpDev->bHasFocusSupplies)
+			res = fad_pd_resume(&gpDev->pdFocus);
+		// Motor rail is powered by SetFocusMotor() when first needed
+		if (gpDev->bHasMotorSupply && !gpDev->bMotorLazyResume)
+			res |= fad_pd_resume(&gpDev->pdMotor);
 	}
 #endif
 	return res;
 }
 
+/**
+ * Lens idle, drop optics and sensor rails
+ * (subject to power off delay)
+ */
+int runtime_suspend(PFAD_HW_INDEP_INFO gpDev)
+{
+	int res = 0;
+
+#ifdef CONFIG_OF
+	if (gpDev->bHasFocusSupplies)
+		res = fad_pd_put(&gpDev->pdFocus, FAD_PD_RUNTIME);
+#endif
+	return res;
+}
+
+int runtime_resume(PFAD_HW_INDEP_INFO gpDev)
+{
+	int res = 0;
+
+#ifdef CONFIG_OF
+	if (gpDev->bHasFocusSupplies)
+		res = fad_pd_get(&gpDev->pdFocus, FAD_PD_RUNTIME);
+#endif
+	return res;
+}
+
 /**
  * Mode for disabling misc regulators during suspend for charging
+ * Motor rail is held in run mode (suspend = 1) and released
+ * in charge mode (suspend = 0), see fad_pd_put() for off delay.
  *
  * @param suspend
  *
@@ -451,36 +458,136 @@ static int SetChargerSuspend(PFAD_HW_INDEP_INFO gpDev, BOOL suspend)
 {
 	int res = 0;
 #ifdef CONFIG_OF
-	if (gpDev->bHasFocusModule) {
-		res = SetMotorSleepRegulator(gpDev, suspend);
+	if (gpDev->bHasMotorSupply) {
+		if (suspend)
+			res = fad_pd_get(&gpDev->pdMotor, FAD_PD_RUN);
+		else
+			res = fad_pd_put(&gpDev->pdMotor, FAD_PD_RUN);
 	}
 #endif
 	return res;
 }
 
-static int SetMotorSleepRegulator(PFAD_HW_INDEP_INFO gpDev, BOOL on)
+/**
+ * Focus subsystem request for the motor rail
+ *
+ * @param on
+ *
+ * @return
+ */
+static int SetFocusMotor(PFAD_HW_INDEP_INFO gpDev, BOOL on)
 {
 	int res = 0;
 #ifdef CONFIG_OF
-	static bool enabled = false;
+	if (gpDev->bHasMotorSupply) {
+		if (on)
+			res = fad_pd_get(&gpDev->pdMotor, FAD_PD_FOCUS);
+		else
+			res = fad_pd_put(&gpDev->pdMotor, FAD_PD_FOCUS);
+	}
+#endif
+	return res;
+}
+
+#ifdef CONFIG_OF
+/**
+ * Charge profile from DT, resources to turn off in charge mode:
+ *   charge-off-domains: power domain names ("focus", "motor")
+ *   charge-off-lines:   FAD output lines ("laser-soft", "laser-switch")
+ *   charge-off-leds:    KAKA LED channels ("red", "blue", "kaka" for both)
+ *
+ * @param gpDev
+ * @param dev
+ */
+static void ReadChargeProfile(PFAD_HW_INDEP_INFO gpDev, struct device *dev)
+{
+	struct fad_charge_profile *cp = &gpDev->chargeProfile;
+	const char *name;
+	BOOL hasRed, hasGreen;
+	int i, n;
+
+	n = of_property_count_strings(dev->of_node, "charge-off-domains");
+	for (i = 0; i < n && cp->num_pd < FAD_CHARGE_DOMAINS; i++) {
+		struct fad_power_domain *pd;
+
+		of_property_read_string_index(dev->of_node, "charge-off-domains", i, &name);
+		pd = fad_pd_find(gpDev, name);
+		if (pd)
+			cp->pd[cp->num_pd++] = pd;
+		else
+			dev_err(dev, "Charge profile: no power domain '%s'\n", name);
+	}
 
-	if (on) {
-		if (!enabled) {
-			res = regulator_enable(gpDev->reg_motor_sleep);
-			enabled = true;
+	n = of_property_count_strings(dev->of_node, "charge-off-lines");
+	for (i = 0; i < n; i++) {
+		of_property_read_string_index(dev->of_node, "charge-off-lines", i, &name);
+		if (!strcmp(name, "laser-soft") && gpDev->laser_soft_gpio)
+			cp->laser_lines |= BIT(FAD_LASER_SOFT);
+		else if (!strcmp(name, "laser-switch") && gpDev->laser_switch_gpio)
+			cp->laser_lines |= BIT(FAD_LASER_SWITCH);
+		else
+			dev_err(dev, "Charge profile: no output line '%s'\n", name);
+	}
+
+	fad_led_has_kaka(gpDev, &hasRed, &hasGreen);
+	n = of_property_count_strings(dev->of_node, "charge-off-leds");
+	for (i = 0; i < n; i++) {
+		BOOL red, green;
+
+		of_property_read_string_index(dev->of_node, "charge-off-leds", i, &name);
+		red = hasRed && (!strcmp(name, "red") || !strcmp(name, "kaka"));
+		green = hasGreen && (!strcmp(name, "blue") || !strcmp(name, "kaka"));
+		if (red || green) {
+			cp->bLedRed |= red;
+			cp->bLedGreen |= green;
 		} else {
-			//If already enabled, silently exit...
-			res = 0;
+			dev_err(dev, "Charge profile: no LED '%s'\n", name);
 		}
-	} else {
-		if (enabled) {
-			res = regulator_disable(gpDev->reg_motor_sleep);
-			enabled = false;
+	}
+}
+#endif
+
+/**
+ * Apply charge profile (charge = TRUE) or restore run state.
+ * Called with semDevice held.
+ *
+ * @param charge
+ *
+ * @return 0 on success
+ */
+static int SetChargeProfile(PFAD_HW_INDEP_INFO gpDev, BOOL charge)
+{
+	int res = 0;
+#ifdef CONFIG_OF
+	struct fad_charge_profile *cp = &gpDev->chargeProfile;
+	int i;
+
+	if (charge == cp->bActive)
+		return 0;
+	cp->bActive = charge;
+
+	// Through the pattern engine, so LED state and loads stay in sync
+	if (cp->bLedRed || cp->bLedGreen) {
+		if (charge) {
+			cp->bLedPattern = fad_led_running(gpDev, &cp->led_pattern,
+							  &cp->led_flash);
+			fad_led_stop(gpDev);
+			fad_led_kaka_levels(gpDev, &cp->led_red, &cp->led_green);
+			fad_led_set_kaka(gpDev, cp->bLedRed ? LED_OFF : cp->led_red,
+					 cp->bLedGreen ? LED_OFF : cp->led_green);
+		} else if (cp->bLedPattern) {
+			fad_led_start(gpDev, &cp->led_pattern, cp->led_flash);
 		} else {
-			//If already disabled, silently exit...
-			res = 0;
+			fad_led_set_kaka(gpDev, cp->led_red, cp->led_green);
 		}
 	}
+
+	// Through laser gating, so the laser IRQ thread cannot turn them on
+	if (cp->laser_lines)
+		SetLaserPointerInhibit(gpDev, charge ? cp->laser_lines : 0);
+
+	for (i = 0; i < cp->num_pd; i++)
+		res |= fad_pd_inhibit(cp->pd[i], charge);
 #endif
 	return res;
 }
@@ -0,0 +1,158 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/***********************************************************************
+ *
+ * Project: Balthazar
+ *
+ * Description of file:
+ *    FLIR Application Driver (FAD) suspend/resume instrumentation.
+ *
+ *  FADDEV Copyright : FLIR Systems AB
+ ***********************************************************************/
+
+#include "flir_kernel_os.h"
+#include "faddev.h"
+#include "fad_internal.h"
+#include <linux/platform_device.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/sort.h>
+
+// Reported phase durations, from one mark to another
+static const struct {
+	const char *name;
+	enum fad_pm_phase from;
+	enum fad_pm_phase to;
+} fad_pm_intervals[] = {
+	{ "ack_wait", FAD_PM_PREPARE, FAD_PM_ACKED },
+	{ "alarm_arm", FAD_PM_ACKED, FAD_PM_ALARM },
+	{ "reg_off", FAD_PM_SUSPEND, FAD_PM_SUSPENDED },
+	{ "standby", FAD_PM_SUSPENDED, FAD_PM_RESUME },
+	{ "reg_on", FAD_PM_RESUME, FAD_PM_RESUMED },
+	{ "thaw", FAD_PM_RESUMED, FAD_PM_POST_SUSPEND },
+	{ "wake_reason", FAD_PM_POST_SUSPEND, FAD_PM_WAKE_REASON },
+	{ "wake_total", FAD_PM_RESUME, FAD_PM_WAKE_REASON },
+};
+
+/**
+ * Record time of a suspend/resume phase.
+ * FAD_PM_PREPARE starts a new cycle, FAD_PM_WAKE_REASON completes it.
+ *
+ * @param data
+ * @param phase
+ */
+void fad_pm_mark(struct faddata *data, enum fad_pm_phase phase)
+{
+	struct fad_pm_timing *t = &data->pm_timing;
+	ktime_t now = ktime_get_boottime();
+	unsigned long flags;
+
+	spin_lock_irqsave(&t->lock, flags);
+	if (phase == FAD_PM_PREPARE)
+		memset(t->cur, 0, sizeof(t->cur));
+	t->cur[phase] = now;
+	if (phase == FAD_PM_WAKE_REASON) {
+		memcpy(t->cycles[t->count % FAD_PM_CYCLES], t->cur, sizeof(t->cur));
+		t->count++;
+	}
+	spin_unlock_irqrestore(&t->lock, flags);
+}
+
+/**
+ * Duration of interval i in a cycle [us], -1 if a phase was not passed
+ */
+static s64 fad_pm_interval(const ktime_t *cycle, int i)
+{
+	ktime_t from = cycle[fad_pm_intervals[i].from];
+	ktime_t to = cycle[fad_pm_intervals[i].to];
+
+	if (!ktime_to_ns(from) || !ktime_to_ns(to))
+		return -1;
+	return ktime_us_delta(to, from);
+}
+
+static int fad_pm_cmp(const void *a, const void *b)
+{
+	s64 x = *(const s64 *)a;
+	s64 y = *(const s64 *)b;
+
+	return (x > y) - (x < y);
+}
+
+static int fad_pm_timing_show(struct seq_file *s, void *unused)
+{
+	struct faddata *data = s->private;
+	struct fad_pm_timing *t = &data->pm_timing;
+	ktime_t (*cycles)[FAD_PM_PHASES];
+	s64 vals[FAD_PM_CYCLES];
+	unsigned int count, n, c;
+	int i;
+
+	cycles = kmalloc(sizeof(t->cycles), GFP_KERNEL);
+	if (!cycles)
+		return -ENOMEM;
+
+	spin_lock_irq(&t->lock);
+	memcpy(cycles, t->cycles, sizeof(t->cycles));
+	count = t->count;
+	spin_unlock_irq(&t->lock);
+	n = min_t(unsigned int, count, FAD_PM_CYCLES);
+
+	seq_printf(s, "cycles: %u, last %u [us]\n%8s", count, n, "cycle");
+	for (i = 0; i < ARRAY_SIZE(fad_pm_intervals); i++)
+		seq_printf(s, " %12s", fad_pm_intervals[i].name);
+	seq_puts(s, "\n");
+
+	for (c = count - n; c < count; c++) {
+		seq_printf(s, "%8u", c);
+		for (i = 0; i < ARRAY_SIZE(fad_pm_intervals); i++) {
+			s64 us = fad_pm_interval(cycles[c % FAD_PM_CYCLES], i);
+
+			if (us < 0)
+				seq_printf(s, " %12s", "-");
+			else
+				seq_printf(s, " %12lld", us);
+		}
+		seq_puts(s, "\n");
+	}
+
+	seq_printf(s, "\n%12s %12s %12s %12s\n", "phase", "p50", "p90", "max");
+	for (i = 0; i < ARRAY_SIZE(fad_pm_intervals); i++) {
+		unsigned int valid = 0;
+
+		for (c = 0; c < n; c++) {
+			s64 us = fad_pm_interval(cycles[c], i);
+
+			if (us >= 0)
+				vals[valid++] = us;
+		}
+		if (!valid)
+			continue;
+		sort(vals, valid, sizeof(vals[0]), fad_pm_cmp, NULL);
+		seq_printf(s, "%12s %12lld %12lld %12lld\n", fad_pm_intervals[i].name,
+			   vals[(valid - 1) * 50 / 100], vals[(valid - 1) * 90 / 100],
+			   vals[valid - 1]);
+	}
+
+	kfree(cycles);
+	return 0;
+}
+
+static int fad_pm_timing_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, fad_pm_timing_show, inode->i_private);
+}
+
+static const struct file_operations fad_pm_timing_fops = {
+	.owner = THIS_MODULE,
+	.open = fad_pm_timing_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+void fad_pm_init(struct faddata *data)
+{
+	spin_lock_init(&data->pm_timing.lock);
+	debugfs_create_file("pm_timing", 0444, data->debugfs, data,
+			    &fad_pm_timing_fops);
+}
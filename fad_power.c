@@ -0,0 +1,291 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/***********************************************************************
+ *
+ * Project: Balthazar
+ *
+ * Description of file:
+ *    FLIR Application Driver (FAD) power domains.
+ *
+ *    A power domain is a set of regulators shared by several consumers.
+ *    Each consumer holds the domain at most once, the domain is powered
+ *    while any consumer holds it. When the last consumer lets go the
+ *    rails are kept on for off_delay_ms, so short flaps (charge/run) do
+ *    not power cycle the hardware.
+ *
+ *  FADDEV Copyright : FLIR Systems AB
+ ***********************************************************************/
+
+#include "flir_kernel_os.h"
+#include "faddev.h"
+#include "fad_internal.h"
+#include <linux/platform_device.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+static const char * const fad_pd_consumer_names[FAD_PD_CONSUMERS] = {
+	[FAD_PD_RUN] = "run",
+	[FAD_PD_FOCUS] = "focus",
+	[FAD_PD_RUNTIME] = "runtime",
+};
+
+// Called with pd->lock held
+static int fad_pd_power(struct fad_power_domain *pd, BOOL on)
+{
+	int ret;
+
+	if (on == pd->bOn)
+		return 0;
+
+	if (on)
+		ret = regulator_bulk_enable(pd->num_supplies, pd->supplies);
+	else
+		ret = regulator_bulk_disable(pd->num_supplies, pd->supplies);
+	if (ret) {
+		dev_err(pd->dev, "%s power %s failed %d\n", pd->name,
+			on ? "on" : "off", ret);
+		return ret;
+	}
+
+	pd->bOn = on;
+	if (!on)
+		pd->power_cycles++;
+	if (pd->load >= 0)
+		fad_load_set(pd->gpDev, pd->load, on);
+	return 0;
+}
+
+static void fad_pd_off_work(struct work_struct *work)
+{
+	struct fad_power_domain *pd = container_of(to_delayed_work(work),
+						   struct fad_power_domain, off_work);
+
+	mutex_lock(&pd->lock);
+	if (!pd->consumers)
+		fad_pd_power(pd, FALSE);
+	mutex_unlock(&pd->lock);
+}
+
+/**
+ * Initialize a power domain and add it to the device's list.
+ * The domain starts unpowered without consumers.
+ *
+ * @param gpDev
+ * @param pd
+ * @param name
+ * @param supplies      Regulators, already acquired
+ * @param num_supplies
+ * @param load          FAD_LOAD_xxx for on-time accounting, -1 for none
+ */
+void fad_pd_init(PFAD_HW_INDEP_INFO gpDev, struct fad_power_domain *pd,
+		 const char *name, struct regulator_bulk_data *supplies,
+		 int num_supplies, int load)
+{
+	struct faddata *data = container_of(gpDev, struct faddata, pDev);
+
+	pd->dev = data->dev;
+	pd->gpDev = gpDev;
+	pd->name = name;
+	pd->load = load;
+	pd->supplies = supplies;
+	pd->num_supplies = num_supplies;
+	pd->off_delay_ms = gpDev->pdOffDelayMs;
+	mutex_init(&pd->lock);
+	INIT_DELAYED_WORK(&pd->off_work, fad_pd_off_work);
+	list_add_tail(&pd->node, &gpDev->power_domains);
+}
+
+/**
+ * Power off and remove domain, regardless of consumers
+ *
+ * @param pd
+ */
+void fad_pd_exit(struct fad_power_domain *pd)
+{
+	cancel_delayed_work_sync(&pd->off_work);
+	mutex_lock(&pd->lock);
+	pd->consumers = 0;
+	fad_pd_power(pd, FALSE);
+	list_del(&pd->node);
+	mutex_unlock(&pd->lock);
+}
+
+/**
+ * Take domain for a consumer, powering it if needed
+ *
+ * @param pd
+ * @param consumer FAD_PD_xxx
+ *
+ * @return 0 on success
+ */
+int fad_pd_get(struct fad_power_domain *pd, enum fad_pd_consumer consumer)
+{
+	int ret;
+
+	mutex_lock(&pd->lock);
+	pd->consumers |= BIT(consumer);
+	pd->bSuspended = FALSE;
+	if (cancel_delayed_work(&pd->off_work))
+		pd->kept_warm++;
+	ret = pd->bInhibited ? 0 : fad_pd_power(pd, TRUE);
+	mutex_unlock(&pd->lock);
+	return ret;
+}
+
+/**
+ * Release domain for a consumer, last one powers off after off_delay_ms
+ *
+ * @param pd
+ * @param consumer FAD_PD_xxx
+ *
+ * @return 0 on success
+ */
+int fad_pd_put(struct fad_power_domain *pd, enum fad_pd_consumer consumer)
+{
+	int ret = 0;
+
+	mutex_lock(&pd->lock);
+	pd->consumers &= ~BIT(consumer);
+	if (!pd->consumers && pd->bOn) {
+		if (pd->off_delay_ms)
+			schedule_delayed_work(&pd->off_work,
+					      msecs_to_jiffies(pd->off_delay_ms));
+		else
+			ret = fad_pd_power(pd, FALSE);
+	}
+	mutex_unlock(&pd->lock);
+	return ret;
+}
+
+/**
+ * System suspend, power off now regardless of consumers and delay.
+ * The off delay does not apply here: the delayed work cannot run
+ * while the system sleeps, so honouring it would keep the rails on
+ * for the whole standby period.
+ *
+ * @param pd
+ *
+ * @return 0 on success
+ */
+int fad_pd_suspend(struct fad_power_domain *pd)
+{
+	int ret;
+
+	cancel_delayed_work_sync(&pd->off_work);
+	mutex_lock(&pd->lock);
+	pd->bSuspended = TRUE;
+	ret = fad_pd_power(pd, FALSE);
+	mutex_unlock(&pd->lock);
+	return ret;
+}
+
+/**
+ * System resume, power on again if held by any consumer.
+ * A domain not resumed stays off until next fad_pd_get().
+ *
+ * @param pd
+ *
+ * @return 0 on success
+ */
+int fad_pd_resume(struct fad_power_domain *pd)
+{
+	int ret = 0;
+
+	mutex_lock(&pd->lock);
+	pd->bSuspended = FALSE;
+	if (pd->consumers && !pd->bInhibited)
+		ret = fad_pd_power(pd, TRUE);
+	mutex_unlock(&pd->lock);
+	return ret;
+}
+
+/**
+ * Keep domain off regardless of consumers (charge profile).
+ * Consumers are still tracked, the domain is powered again
+ * when the inhibit is lifted.
+ *
+ * @param pd
+ * @param inhibit
+ *
+ * @return 0 on success
+ */
+int fad_pd_inhibit(struct fad_power_domain *pd, BOOL inhibit)
+{
+	int ret = 0;
+
+	cancel_delayed_work_sync(&pd->off_work);
+	mutex_lock(&pd->lock);
+	pd->bInhibited = inhibit;
+	if (inhibit)
+		ret = fad_pd_power(pd, FALSE);
+	else if (pd->consumers && !pd->bSuspended)
+		ret = fad_pd_power(pd, TRUE);
+	mutex_unlock(&pd->lock);
+	return ret;
+}
+
+struct fad_power_domain *fad_pd_find(PFAD_HW_INDEP_INFO gpDev, const char *name)
+{
+	struct fad_power_domain *pd;
+
+	list_for_each_entry(pd, &gpDev->power_domains, node)
+		if (!strcmp(pd->name, name))
+			return pd;
+	return NULL;
+}
+
+void fad_pd_set_off_delay(PFAD_HW_INDEP_INFO gpDev, unsigned int ms)
+{
+	struct fad_power_domain *pd;
+
+	gpDev->pdOffDelayMs = ms;
+	list_for_each_entry(pd, &gpDev->power_domains, node) {
+		mutex_lock(&pd->lock);
+		pd->off_delay_ms = ms;
+		mutex_unlock(&pd->lock);
+	}
+}
+
+static int fad_power_domains_show(struct seq_file *s, void *unused)
+{
+	struct faddata *data = s->private;
+	struct fad_power_domain *pd;
+	int i;
+
+	seq_printf(s, "%-10s %-5s %-9s %8s %8s %10s  %s\n", "domain", "state",
+		   "pending", "delay", "cycles", "kept_warm", "consumers");
+	list_for_each_entry(pd, &data->pDev.power_domains, node) {
+		mutex_lock(&pd->lock);
+		seq_printf(s, "%-10s %-5s %-9s %8u %8u %10u ", pd->name,
+			   pd->bOn ? "on" : "off",
+			   pd->bInhibited ? "inhibit" :
+			   delayed_work_pending(&pd->off_work) ? "off" :
+			   (pd->bSuspended && pd->consumers) ? "resume" : "-",
+			   pd->off_delay_ms, pd->power_cycles, pd->kept_warm);
+		for (i = 0; i < FAD_PD_CONSUMERS; i++)
+			if (pd->consumers & BIT(i))
+				seq_printf(s, " %s", fad_pd_consumer_names[i]);
+		seq_puts(s, "\n");
+		mutex_unlock(&pd->lock);
+	}
+	return 0;
+}
+
+static int fad_power_domains_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, fad_power_domains_show, inode->i_private);
+}
+
+static const struct file_operations fad_power_domains_fops = {
+	.owner = THIS_MODULE,
+	.open = fad_power_domains_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+// power_domains is initialized in probe, domains are added by platform setup
+void fad_power_init(struct faddata *data)
+{
+	debugfs_create_file("power_domains", 0444, data->debugfs, data,
+			    &fad_power_domains_fops);
+}
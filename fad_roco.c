@@ -42,14 +42,12 @@ static DWORD SetKeypadSubjBacklight(PFAD_HW_INDEP_INFO gpDev,
 				    PFADDEVIOCTLSUBJBACKLIGHT pBacklight);
 static DWORD GetKeypadSubjBacklight(PFAD_HW_INDEP_INFO gpDev,
 				    PFADDEVIOCTLSUBJBACKLIGHT pBacklight);
+static void SetKeypadLevel(PFAD_HW_INDEP_INFO gpDev, int brightness);
+static int GetKeypadLevel(PFAD_HW_INDEP_INFO gpDev);
 static BOOL setGPSEnable(BOOL on);
 static BOOL getGPSEnable(BOOL *on);
 static void WdogInit(PFAD_HW_INDEP_INFO gpDev, UINT32 Timeout);
 static BOOL WdogService(PFAD_HW_INDEP_INFO gpDev);
-#ifdef CONFIG_OF
-static void BspGetSubjBackLightLevel(UINT8 * pLow, UINT8 * pMedium,
-				     UINT8 * pHigh);
-#endif
 static void CleanupHW(PFAD_HW_INDEP_INFO gpDev);
 
 // Code
@@ -59,9 +57,7 @@ int SetupMX6Q(PFAD_HW_INDEP_INFO gpDev)
 	int retval = 0;
 #ifdef CONFIG_OF
 	u32 tmp;
-	extern struct list_head leds_list;
-	extern struct rw_semaphore leds_list_lock;
-	struct led_classdev *led_cdev;
+	struct faddata *data = container_of(gpDev, struct faddata, pDev);
 #endif
 
 	gpDev->pGetKAKALedState = getKAKALedState;
@@ -72,6 +68,8 @@ int SetupMX6Q(PFAD_HW_INDEP_INFO gpDev)
 	gpDev->pGetKeypadBacklight = NULL;
 	gpDev->pSetKeypadSubjBacklight = SetKeypadSubjBacklight;
 	gpDev->pGetKeypadSubjBacklight = GetKeypadSubjBacklight;
+	gpDev->pSetKeypadLevel = SetKeypadLevel;
+	gpDev->pGetKeypadLevel = GetKeypadLevel;
 	gpDev->pSetGPSEnable = setGPSEnable;
 	gpDev->pGetGPSEnable = getGPSEnable;
 	gpDev->pSetChargerSuspend = NULL;
@@ -80,6 +78,12 @@ int SetupMX6Q(PFAD_HW_INDEP_INFO gpDev)
 	gpDev->pCleanupHW = CleanupHW;
 
 #ifdef CONFIG_OF
+	// Find LEDs first, nothing to undo if their driver has not bound yet
+	retval = fad_led_get(data->dev, "pike", "pikeled", &gpDev->pike_cdev);
+	if (!retval)
+		retval = fad_led_get(data->dev, "pijk", "pijkled", &gpDev->pijk_cdev);
+	if (retval)
+		return retval;
 
 	retval = SetupLaserPointer(gpDev);
 	if (retval) {
@@ -87,18 +91,6 @@ int SetupMX6Q(PFAD_HW_INDEP_INFO gpDev)
 		goto EXIT;
 	}
 
-//      pr_err("Searching for LEDs\n");
-	down_read(&leds_list_lock);
-	list_for_each_entry(led_cdev, &leds_list, node) {
-		if (strcmp(led_cdev->name, "pikeled") == 0) {
-			gpDev->pike_cdev = led_cdev;
-
-		} else if (strcmp(led_cdev->name, "pijkled") == 0) {
-			gpDev->pijk_cdev = led_cdev;
-		}
-	}
-	up_read(&leds_list_lock);
-
 /* Configure I2C from Devicetree */
 	retval = of_property_read_u32_index(gpDev->node, "hI2C1", 0, &tmp);
 	if (retval) {
@@ -135,9 +127,7 @@ int SetupMX6Q(PFAD_HW_INDEP_INFO gpDev)
 				   &gpDev->bHasBuzzer);
 	of_property_read_u32_index(gpDev->node, "HasKpBacklight", 0,
 				   &gpDev->bHasKpBacklight);
-	BspGetSubjBackLightLevel(&gpDev->Keypad_bl_low,
-				 &gpDev->Keypad_bl_medium,
-				 &gpDev->Keypad_bl_high);
+	fad_kp_levels_init(gpDev);
 
 	gpDev->reg_opt3v6 =
 	    regulator_get(&gpDev->pLinuxDevice->dev, "rori_opt_3v6");
@@ -247,25 +237,25 @@ DWORD SetKeypadSubjBacklight(PFAD_HW_INDEP_INFO gpDev,
 			     PFADDEVIOCTLSUBJBACKLIGHT pBacklight)
 {
 	int brightness;
-//      pr_err("flirdrv-fad: SetKeypadSubjBacklight!\n");
-	switch (pBacklight->subjectiveBacklight) {
-	case KP_SUBJ_LOW:
-		brightness = gpDev->Keypad_bl_low;
-		break;
-	case KP_SUBJ_MEDIUM:
-		brightness = gpDev->Keypad_bl_medium;
-		break;
-	case KP_SUBJ_HIGH:
-		brightness = gpDev->Keypad_bl_high;
-		break;
-	case KP_SUBJ_OFF:
-		brightness = 0;
-		break;
-	default:
-		brightness = 0;
-		break;
-	}
 
+	brightness = fad_kp_subj_to_brightness(gpDev, pBacklight->subjectiveBacklight);
+	if (brightness < 0)
+		return ERROR_INVALID_PARAMETER;
+
+	fad_kp_fade_stop(gpDev);
+	SetKeypadLevel(gpDev, brightness);
+
+	return ERROR_SUCCESS;
+}
+
+/**
+ * Set both keypad backlight LEDs, also used by the fade engine
+ *
+ * @param gpDev
+ * @param brightness
+ */
+void SetKeypadLevel(PFAD_HW_INDEP_INFO gpDev, int brightness)
+{
 #ifdef CONFIG_OF
 	gpDev->pijk_cdev->brightness = brightness;
 	gpDev->pijk_cdev->brightness_set(gpDev->pijk_cdev,
@@ -275,8 +265,15 @@ DWORD SetKeypadSubjBacklight(PFAD_HW_INDEP_INFO gpDev,
 	gpDev->pike_cdev->brightness_set(gpDev->pike_cdev,
 					 gpDev->pike_cdev->brightness);
 #endif
+}
 
-	return ERROR_SUCCESS;
+int GetKeypadLevel(PFAD_HW_INDEP_INFO gpDev)
+{
+#ifdef CONFIG_OF
+	return gpDev->pike_cdev->brightness;
+#else
+	return 0;
+#endif
 }
 
 /**
@@ -297,37 +294,10 @@ DWORD GetKeypadSubjBacklight(PFAD_HW_INDEP_INFO gpDev,
 			     PFADDEVIOCTLSUBJBACKLIGHT pBacklight)
 {
 #ifdef CONFIG_OF
-	int brightness;
-
-	UINT8 bl_value;
-
-	brightness = gpDev->pike_cdev->brightness;
-
-	bl_value = (UINT8) brightness;
-
-	if (brightness == 0)
-		pBacklight->subjectiveBacklight = KP_SUBJ_LOW;
-	else if (brightness <=
-		 gpDev->Keypad_bl_low + (gpDev->Keypad_bl_medium -
-					 gpDev->Keypad_bl_low) / 2)
-		pBacklight->subjectiveBacklight = KP_SUBJ_LOW;
-	else if (brightness <=
-		 gpDev->Keypad_bl_medium + (gpDev->Keypad_bl_high -
-					    gpDev->Keypad_bl_medium) / 2)
-		pBacklight->subjectiveBacklight = KP_SUBJ_MEDIUM;
-	else
-		pBacklight->subjectiveBacklight = KP_SUBJ_HIGH;
+	pBacklight->subjectiveBacklight =
+		fad_kp_brightness_to_subj(gpDev, gpDev->pike_cdev->brightness);
 #endif
 
 	// RETAILMSG(1, (_T("GetKeypadSubjBacklight %x\r\n"),pBacklight->subjectiveBacklight));
 	return ERROR_SUCCESS;
 }
-
-#ifdef CONFIG_OF
-void BspGetSubjBackLightLevel(UINT8 *pLow, UINT8 *pMedium, UINT8 *pHigh)
-{
-	*pLow = 10;
-	*pMedium = 40;
-	*pHigh = 75;
-}
-#endif
@@ -0,0 +1,140 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/***********************************************************************
+ *
+ * Project: Balthazar
+ *
+ * Description of file:
+ *    FLIR Application Driver (FAD) on-time accounting of controlled loads.
+ *
+ *    Control paths report each load switching with fad_load_set(),
+ *    on-time is accumulated in CLOCK_BOOTTIME so time in standby with a
+ *    load left on is included.
+ *
+ *  FADDEV Copyright : FLIR Systems AB
+ ***********************************************************************/
+
+#include "flir_kernel_os.h"
+#include "faddev.h"
+#include "fad_internal.h"
+#include <linux/platform_device.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+static const char * const fad_load_names[FAD_LOADS] = {
+	[FAD_LOAD_LASER] = "laser",
+	[FAD_LOAD_OPTICS] = "optics",
+	[FAD_LOAD_MOTOR] = "motor",
+	[FAD_LOAD_RED_LED] = "red_led",
+	[FAD_LOAD_BLUE_LED] = "blue_led",
+	[FAD_LOAD_BUZZER] = "buzzer",
+};
+
+/**
+ * Account one of several sources switching a load on or off. The load
+ * is on while any source holds it, repeated states are ignored.
+ *
+ * @param gpDev
+ * @param load   FAD_LOAD_xxx
+ * @param src    Source, e.g. FAD_LASER_SRC_xxx, below BITS_PER_LONG
+ * @param on
+ */
+void fad_load_src_set(PFAD_HW_INDEP_INFO gpDev, int load, int src, BOOL on)
+{
+	struct fad_load_stat *ls = &gpDev->loads[load];
+	ktime_t now = ktime_get_boottime();
+	unsigned long flags;
+
+	spin_lock_irqsave(&gpDev->loadLock, flags);
+	if (on)
+		ls->sources |= BIT(src);
+	else
+		ls->sources &= ~BIT(src);
+	if (!ls->sources == !ls->bOn) {
+		spin_unlock_irqrestore(&gpDev->loadLock, flags);
+		return;
+	}
+	if (ls->sources)
+		ls->since = now;
+	else
+		ls->on_ns += ktime_to_ns(ktime_sub(now, ls->since));
+	ls->bOn = ls->sources ? TRUE : FALSE;
+	ls->transitions++;
+	spin_unlock_irqrestore(&gpDev->loadLock, flags);
+}
+
+/**
+ * Account a load with a single source switching on or off
+ *
+ * @param gpDev
+ * @param load   FAD_LOAD_xxx
+ * @param on
+ */
+void fad_load_set(PFAD_HW_INDEP_INFO gpDev, int load, BOOL on)
+{
+	fad_load_src_set(gpDev, load, 0, on);
+}
+
+/**
+ * Consistent copy of all load counters, for IOCTL_FAD_GET_LOAD_STATS
+ *
+ * @param gpDev
+ * @param pStats
+ */
+void fad_load_snapshot(PFAD_HW_INDEP_INFO gpDev, PFADDEVIOCTLLOADSTATS pStats)
+{
+	ktime_t now = ktime_get_boottime();
+	unsigned long flags;
+	int i;
+
+	memset(pStats, 0, sizeof(*pStats));
+	pStats->ullTimestamp = ktime_to_ns(now);
+	pStats->ulLoads = FAD_LOADS;
+
+	spin_lock_irqsave(&gpDev->loadLock, flags);
+	for (i = 0; i < FAD_LOADS; i++) {
+		struct fad_load_stat *ls = &gpDev->loads[i];
+
+		pStats->load[i].ullOnTime = ls->on_ns;
+		if (ls->bOn)
+			pStats->load[i].ullOnTime += ktime_to_ns(ktime_sub(now, ls->since));
+		pStats->load[i].ulTransitions = ls->transitions;
+		pStats->load[i].bOn = ls->bOn;
+	}
+	spin_unlock_irqrestore(&gpDev->loadLock, flags);
+}
+
+static int fad_loads_show(struct seq_file *s, void *unused)
+{
+	struct faddata *data = s->private;
+	FADDEVIOCTLLOADSTATS stats;
+	int i;
+
+	fad_load_snapshot(&data->pDev, &stats);
+	seq_printf(s, "%-10s %-5s %16s %12s\n", "load", "state", "on_time_ms",
+		   "transitions");
+	for (i = 0; i < FAD_LOADS; i++)
+		seq_printf(s, "%-10s %-5s %16llu %12u\n", fad_load_names[i],
+			   stats.load[i].bOn ? "on" : "off",
+			   div_u64(stats.load[i].ullOnTime, NSEC_PER_MSEC),
+			   (unsigned int)stats.load[i].ulTransitions);
+	return 0;
+}
+
+static int fad_loads_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, fad_loads_show, inode->i_private);
+}
+
+static const struct file_operations fad_loads_fops = {
+	.owner = THIS_MODULE,
+	.open = fad_loads_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+// loadLock is initialized in probe, loads switch during platform setup
+void fad_stats_init(struct faddata *data)
+{
+	debugfs_create_file("loads", 0444, data->debugfs, data, &fad_loads_fops);
+}
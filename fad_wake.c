@@ -0,0 +1,181 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/***********************************************************************
+ *
+ * Project: Balthazar
+ *
+ * Description of file:
+ *    FLIR Application Driver (FAD) wake reason classification.
+ *
+ *    Wakeup sources are mapped to wake reasons by a table, from DT
+ *    (wake-reason-sources/wake-reason-ids) or the built in default.
+ *    Sources are resolved to wakeup_source pointers once, by name at
+ *    probe where the kernel allows walking wakeup sources, otherwise
+ *    the first time they wake the camera.
+ *
+ *  FADDEV Copyright : FLIR Systems AB
+ ***********************************************************************/
+
+#include "flir_kernel_os.h"
+#include "faddev.h"
+#include "fad_internal.h"
+#include <linux/platform_device.h>
+#include <linux/pm_wakeup.h>
+#include <linux/of.h>
+#include "flir-kernel-version.h"
+
+static const char * const fad_wake_reason_names[FAD_WAKE_REASONS] = {
+	[UNKNOWN_WAKE] = "unknown",
+	[ON_OFF_BUTTON_WAKE] = "onkey",
+	[USB_CABLE_WAKE] = "usb",
+	[TIMELAPSE_WAKE] = "timelapse",
+	[RTC_WAKE] = "rtc",
+	[INPUT_WAKE] = "input",
+};
+
+// Used without DT table, same matching as before the table existed
+static const struct {
+	const char *name;
+	int reason;
+} fad_wake_default[] = {
+	{ "onkey", ON_OFF_BUTTON_WAKE },
+	{ "wake", USB_CABLE_WAKE },
+	{ "rtc", RTC_WAKE },
+};
+
+const char *fad_wake_reason_name(int reason)
+{
+	if (reason < 0 || reason >= FAD_WAKE_REASONS)
+		return fad_wake_reason_names[UNKNOWN_WAKE];
+	return fad_wake_reason_names[reason];
+}
+
+static void fad_wake_add(struct faddata *data, const char *name, int reason,
+			 struct wakeup_source *ws)
+{
+	struct fad_wake_source *src;
+
+	if (data->num_wake_sources >= FAD_WAKE_SOURCES) {
+		dev_err(data->dev, "Too many wake reason sources, '%s' ignored\n", name);
+		return;
+	}
+	if (reason < 0 || reason >= FAD_WAKE_REASONS) {
+		dev_err(data->dev, "Invalid wake reason %d for '%s'\n", reason, name);
+		return;
+	}
+	src = &data->wake_sources[data->num_wake_sources++];
+	src->name = name;
+	src->reason = reason;
+	src->ws = ws;
+}
+
+#if KERNEL_VERSION(5, 4, 0) <= LINUX_VERSION_CODE
+/**
+ * Resolve table entries to registered wakeup sources by exact name
+ */
+static void fad_wake_resolve(struct faddata *data)
+{
+	struct wakeup_source *ws;
+	int idx, i;
+
+	idx = wakeup_sources_read_lock();
+	for (ws = wakeup_sources_walk_start(); ws; ws = wakeup_sources_walk_next(ws)) {
+		for (i = 0; i < data->num_wake_sources; i++) {
+			struct fad_wake_source *src = &data->wake_sources[i];
+
+			if (!src->ws && !strcmp(ws->name, src->name))
+				src->ws = ws;
+		}
+	}
+	wakeup_sources_read_unlock(idx);
+}
+#endif
+
+/**
+ * Build wakeup source table, call after InitIrqWake()
+ *
+ * @param data
+ */
+void fad_wake_init(struct faddata *data)
+{
+	struct device *dev = data->dev;
+	int n = -EINVAL;
+	int i;
+
+#ifdef CONFIG_OF
+	n = of_property_count_strings(dev->of_node, "wake-reason-sources");
+#endif
+	if (n > 0) {
+		for (i = 0; i < n; i++) {
+			const char *name;
+			u32 reason;
+
+			if (of_property_read_string_index(dev->of_node, "wake-reason-sources",
+							  i, &name) ||
+			    of_property_read_u32_index(dev->of_node, "wake-reason-ids",
+						       i, &reason)) {
+				dev_err(dev, "Bad wake reason entry %d\n", i);
+				continue;
+			}
+			fad_wake_add(data, name, reason, NULL);
+		}
+	} else {
+		for (i = 0; i < ARRAY_SIZE(fad_wake_default); i++)
+			fad_wake_add(data, fad_wake_default[i].name,
+				     fad_wake_default[i].reason, NULL);
+	}
+
+	// Our own input IRQs, see SetIrqWake()
+	if (data->pDev.ws)
+		fad_wake_add(data, data->pDev.ws->name, INPUT_WAKE, data->pDev.ws);
+
+#if KERNEL_VERSION(5, 4, 0) <= LINUX_VERSION_CODE
+	fad_wake_resolve(data);
+#endif
+}
+
+/**
+ * Map wakeup source to wake reason.
+ * Known sources are matched by pointer, others by name (substring)
+ * and then remembered.
+ *
+ * @param data
+ * @param ws   Source that woke the camera, may be NULL
+ *
+ * @return WAKE_REASON
+ */
+int fad_wake_classify(struct faddata *data, struct wakeup_source *ws)
+{
+	int i;
+
+	if (!ws)
+		return UNKNOWN_WAKE;
+
+	for (i = 0; i < data->num_wake_sources; i++)
+		if (data->wake_sources[i].ws == ws)
+			return data->wake_sources[i].reason;
+
+	for (i = 0; i < data->num_wake_sources; i++) {
+		struct fad_wake_source *src = &data->wake_sources[i];
+
+		if (strstr(ws->name, src->name)) {
+			if (!src->ws)
+				src->ws = ws;
+			return src->reason;
+		}
+	}
+	return UNKNOWN_WAKE;
+}
+
+/**
+ * Count a wakeup for telemetry
+ *
+ * @param data
+ * @param reason WAKE_REASON
+ */
+void fad_wake_count(struct faddata *data, int reason)
+{
+	if (reason < 0 || reason >= FAD_WAKE_REASONS)
+		reason = UNKNOWN_WAKE;
+	data->last_wake = reason;
+	data->wake_counts[reason]++;
+}
@@ -25,7 +25,10 @@
 #include <linux/alarmtimer.h>
 #include <linux/reboot.h>
 #include <linux/backlight.h>
+#include <linux/fb.h>
 #include <linux/kernel.h>
+#include <linux/debugfs.h>
+#include <linux/pm_runtime.h>
 #include <../drivers/base/power/power.h>
 #if KERNEL_VERSION(3, 10, 0) <= LINUX_VERSION_CODE
 #include <asm/system_info.h>
@@ -51,10 +54,31 @@ module_param(standby_on_timer, long, 0);
 MODULE_PARM_DESC(standby_on_timer,
 		 "Standby-to-wakeup timer [min], overrides standby_off_timer, 0 to disable");
 
+static unsigned int standby_ack_timeout = 10000;
+module_param(standby_ack_timeout, uint, 0);
+MODULE_PARM_DESC(standby_ack_timeout,
+		 "Max wait for fadsuspend standby ack [ms], 0 to only wait for registered clients");
+
+static unsigned int timelapse_interval;
+module_param(timelapse_interval, uint, 0);
+MODULE_PARM_DESC(timelapse_interval,
+		 "Timelapse wake interval in standby [s], overrides standby timers, 0 to disable. "
+		 "Needs autosleep or a suspend daemon to suspend between wakes");
+
+static unsigned int timelapse_window = 5000;
+module_param(timelapse_window, uint, 0);
+MODULE_PARM_DESC(timelapse_window,
+		 "Max time a timelapse capture holds off suspend [ms]");
+
 // Function prototypes
 static long FAD_IOControl(struct file *filep, unsigned int cmd, unsigned long arg);
 static unsigned int FadPoll(struct file *filep, poll_table *pt);
 static ssize_t FadRead(struct file *filep, char __user *buf, size_t count, loff_t *f_pos);
+static int FadOpen(struct inode *inode, struct file *filep);
+static int FadRelease(struct inode *inode, struct file *filep);
+#ifdef CONFIG_OF
+static void fad_backlight_restore(struct faddata *data);
+#endif
 
 #if KERNEL_VERSION(4, 0, 0) > LINUX_VERSION_CODE
 //Workaround to allow 3.14 kernel to work...
@@ -63,6 +87,8 @@ struct platform_device *pdev;
 
 static const struct file_operations fad_fops = {
 	.owner = THIS_MODULE,
+	.open = FadOpen,
+	.release = FadRelease,
 	.unlocked_ioctl = FAD_IOControl,
 	.read = FadRead,
 	.poll = FadPoll,
@@ -178,35 +204,74 @@ static ssize_t fadsuspend_show(struct device *dev, struct device_attribute *attr
 	return charge_state_show(dev, attr, buf);
 }
 
-static ssize_t fadsuspend_store(struct device *dev, struct device_attribute *attr,
-				const char *buf, size_t len)
+/**
+ * Application standby handshake, from sysfs or IOCTL_FAD_SUSPEND_ACK
+ *
+ * @param data
+ * @param ok    Application is ready for standby
+ */
+static void fad_suspend_ack(struct faddata *data, BOOL ok)
 {
-	struct faddata *data = dev_get_drvdata(dev);
-
 	if (data->pDev.bSuspend) {
-		if ((len == 1) && (*buf == '1'))
+		if (ok)
 			data->pDev.bSuspend = 0;
 		else
-			dev_err(dev, "App standby prepare fail %d %c\n", len,
-			       (len > 0) ? *buf : ' ');
+			dev_err(data->dev, "App standby prepare fail\n");
 		complete(&data->pDev.standbyComplete);
 	} else
-		dev_dbg(dev, "App resume\n");
+		dev_dbg(data->dev, "App resume\n");
+}
+
+static ssize_t fadsuspend_store(struct device *dev, struct device_attribute *attr,
+				const char *buf, size_t len)
+{
+	struct faddata *data = dev_get_drvdata(dev);
+
+	fad_suspend_ack(data, (len == 1) && (*buf == '1'));
 
 	return sizeof(char);
 }
 
+/**
+ * Enter run or charge state, applying the charge profile
+ *
+ * @param data
+ * @param state ON_STATE or USB_CHARGE_STATE
+ */
+static void fad_set_power_state(struct faddata *data, int state)
+{
+	power_state = state;
+	if (data->pDev.pSetChargeProfile) {
+		down(&data->pDev.semDevice);
+		if (data->pDev.pSetChargeProfile(&data->pDev, state == USB_CHARGE_STATE))
+			dev_err(data->dev, "Charge profile %s failed\n",
+				state == USB_CHARGE_STATE ? "apply" : "revert");
+		up(&data->pDev.semDevice);
+	}
+	fad_ldm_pause_sampling(FAD_LDM_PAUSE_CHARGE, state == USB_CHARGE_STATE);
+#ifdef CONFIG_OF
+	// Backlight saved at standby stays blanked through charge mode
+	if (state == ON_STATE)
+		fad_backlight_restore(data);
+#endif
+}
+
 static ssize_t charge_state_store(struct device *dev, struct device_attribute *attr,
 				  const char *buf, size_t len)
 {
+	struct faddata *data = dev_get_drvdata(dev);
+
 	if (!strncmp(buf, "run", strlen("run")))
-		power_state = ON_STATE;
+		fad_set_power_state(data, ON_STATE);
 	else if (!strncmp(buf, "charge", strlen("charge")))
-		power_state = USB_CHARGE_STATE;
+		fad_set_power_state(data, USB_CHARGE_STATE);
 	else
 		return -EINVAL;
 
 	sysfs_notify(&dev->kobj, "control", "fadsuspend");
+	ApplicationEventRecord(&data->pDev, (power_state == USB_CHARGE_STATE) ?
+			       FAD_CHARGE_MODE_EVENT : FAD_RESUMED_EVENT,
+			       ktime_get(), data->wake_reason, 0);
 	return len;
 }
 
@@ -266,6 +331,150 @@ static ssize_t standby_on_timer_store(struct device *dev, struct device_attribut
 	return ret;
 }
 
+/**
+ * The driver never starts a suspend. Between timelapse windows
+ * autosleep or a suspend daemon must, else the camera stays awake
+ * and each window is opened by the alarm while awake.
+ */
+static void fad_timelapse_check(struct device *dev)
+{
+	if (timelapse_interval && !IS_ENABLED(CONFIG_PM_AUTOSLEEP))
+		dev_warn(dev, "Timelapse without autosleep, a suspend daemon must suspend between wakes\n");
+}
+
+static ssize_t timelapse_interval_show(struct device *dev, struct device_attribute *attr,
+				       char *buf)
+{
+	return sprintf(buf, "%u\n", timelapse_interval);
+}
+
+static ssize_t timelapse_interval_store(struct device *dev, struct device_attribute *attr,
+					const char *buf, size_t len)
+{
+	unsigned int val;
+	int ret = kstrtouint(buf, 10, &val);
+
+	if (ret < 0)
+		return ret;
+	dev_dbg(dev, "Timelapse interval set to %u s\n", val);
+	timelapse_interval = val;
+	fad_timelapse_check(dev);
+	return len;
+}
+
+static ssize_t timelapse_window_ms_show(struct device *dev, struct device_attribute *attr,
+					char *buf)
+{
+	return sprintf(buf, "%u\n", timelapse_window);
+}
+
+static ssize_t timelapse_window_ms_store(struct device *dev, struct device_attribute *attr,
+					 const char *buf, size_t len)
+{
+	unsigned int val;
+	int ret = kstrtouint(buf, 10, &val);
+
+	if (ret < 0)
+		return ret;
+	timelapse_window = val;
+	return len;
+}
+
+static ssize_t ldm_max_rate_hz_show(struct device *dev, struct device_attribute *attr,
+				    char *buf)
+{
+	return sprintf(buf, "%u\n", fad_ldm_get_max_rate());
+}
+
+static ssize_t ldm_max_rate_hz_store(struct device *dev, struct device_attribute *attr,
+				     const char *buf, size_t len)
+{
+	u32 val;
+	int ret = kstrtou32(buf, 10, &val);
+
+	if (ret < 0)
+		return ret;
+	fad_ldm_set_max_rate(val);
+	return len;
+}
+
+static ssize_t ldm_sample_interval_ms_show(struct device *dev, struct device_attribute *attr,
+					   char *buf)
+{
+	return sprintf(buf, "%u\n", fad_ldm_get_sample_interval());
+}
+
+static ssize_t ldm_sample_interval_ms_store(struct device *dev, struct device_attribute *attr,
+					    const char *buf, size_t len)
+{
+	u32 val;
+	int ret = kstrtou32(buf, 10, &val);
+
+	if (ret < 0)
+		return ret;
+	fad_ldm_set_sample_interval(val);
+	return len;
+}
+
+static ssize_t ldm_max_duty_pct_show(struct device *dev, struct device_attribute *attr,
+				     char *buf)
+{
+	return sprintf(buf, "%u\n", fad_ldm_get_max_duty());
+}
+
+static ssize_t ldm_max_duty_pct_store(struct device *dev, struct device_attribute *attr,
+				      const char *buf, size_t len)
+{
+	u32 val;
+	int ret = kstrtou32(buf, 10, &val);
+
+	if (ret < 0)
+		return ret;
+	ret = fad_ldm_set_max_duty(val);
+	return ret ? ret : len;
+}
+
+static ssize_t backlight_instant_on_show(struct device *dev, struct device_attribute *attr,
+					 char *buf)
+{
+	struct faddata *data = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%d\n", data->bBacklightInstantOn ? 1 : 0);
+}
+
+static ssize_t backlight_instant_on_store(struct device *dev, struct device_attribute *attr,
+					  const char *buf, size_t len)
+{
+	struct faddata *data = dev_get_drvdata(dev);
+	bool val;
+	int ret = strtobool(buf, &val);
+
+	if (ret < 0)
+		return ret;
+	data->bBacklightInstantOn = val;
+	return len;
+}
+
+static ssize_t wake_last_show(struct device *dev, struct device_attribute *attr,
+			      char *buf)
+{
+	struct faddata *data = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%s\n", fad_wake_reason_name(data->last_wake));
+}
+
+static ssize_t wake_counts_show(struct device *dev, struct device_attribute *attr,
+				char *buf)
+{
+	struct faddata *data = dev_get_drvdata(dev);
+	ssize_t len = 0;
+	int i;
+
+	for (i = 0; i < FAD_WAKE_REASONS; i++)
+		len += sprintf(buf + len, "%s %u\n", fad_wake_reason_name(i),
+			       data->wake_counts[i]);
+	return len;
+}
 
 static ssize_t chargersuspend_store(struct device *dev, struct device_attribute *attr,
 				    const char *buf, size_t len)
@@ -288,10 +497,87 @@ static ssize_t chargersuspend_store(struct device *dev, struct device_attribute
 	return ret;
 }
 
+/**
+ * Trigger press counter and CLOCK_MONOTONIC time of last press
+ * "<count> <sec>.<nsec>"
+ */
 static ssize_t trigger_poll_show(struct device *dev, struct device_attribute *attr, char *buf)
 {
-	strcpy(buf, "X\n");
-	return strlen(buf);
+	struct faddata *data = dev_get_drvdata(dev);
+	struct fad_trigger *trig = &data->pDev.trigger;
+	UINT32 count;
+	s64 sec;
+	s32 nsec;
+
+	spin_lock_irq(&trig->lock);
+	count = trig->press_count;
+	sec = div_s64_rem(ktime_to_ns(trig->press), NSEC_PER_SEC, &nsec);
+	spin_unlock_irq(&trig->lock);
+
+	return sprintf(buf, "%u %lld.%09d\n", count, sec, nsec);
+}
+
+static ssize_t trigger_long_press_ms_show(struct device *dev, struct device_attribute *attr,
+					  char *buf)
+{
+	struct faddata *data = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", data->pDev.trigger.long_press_ms);
+}
+
+static ssize_t trigger_long_press_ms_store(struct device *dev, struct device_attribute *attr,
+					   const char *buf, size_t len)
+{
+	struct faddata *data = dev_get_drvdata(dev);
+	u32 val;
+	int ret = kstrtou32(buf, 10, &val);
+
+	if (ret < 0)
+		return ret;
+	data->pDev.trigger.long_press_ms = val;
+	return len;
+}
+
+static ssize_t trigger_double_press_ms_show(struct device *dev, struct device_attribute *attr,
+					    char *buf)
+{
+	struct faddata *data = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", data->pDev.trigger.double_press_ms);
+}
+
+static ssize_t trigger_double_press_ms_store(struct device *dev, struct device_attribute *attr,
+					     const char *buf, size_t len)
+{
+	struct faddata *data = dev_get_drvdata(dev);
+	u32 val;
+	int ret = kstrtou32(buf, 10, &val);
+
+	if (ret < 0)
+		return ret;
+	data->pDev.trigger.double_press_ms = val;
+	return len;
+}
+
+static ssize_t power_off_delay_ms_show(struct device *dev, struct device_attribute *attr,
+				       char *buf)
+{
+	struct faddata *data = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", data->pDev.pdOffDelayMs);
+}
+
+static ssize_t power_off_delay_ms_store(struct device *dev, struct device_attribute *attr,
+					const char *buf, size_t len)
+{
+	struct faddata *data = dev_get_drvdata(dev);
+	u32 val;
+	int ret = kstrtou32(buf, 10, &val);
+
+	if (ret < 0)
+		return ret;
+	fad_pd_set_off_delay(&data->pDev, val);
+	return len;
 }
 
 static DEVICE_ATTR_RW(standby_off_timer);
@@ -300,6 +586,17 @@ static DEVICE_ATTR_RW(charge_state);
 static DEVICE_ATTR_RW(fadsuspend);
 static DEVICE_ATTR(chargersuspend, 0644, NULL, chargersuspend_store);
 static DEVICE_ATTR_RO(trigger_poll);
+static DEVICE_ATTR_RW(trigger_long_press_ms);
+static DEVICE_ATTR_RW(trigger_double_press_ms);
+static DEVICE_ATTR_RW(power_off_delay_ms);
+static DEVICE_ATTR_RW(timelapse_interval);
+static DEVICE_ATTR_RW(timelapse_window_ms);
+static DEVICE_ATTR_RW(backlight_instant_on);
+static DEVICE_ATTR_RW(ldm_max_rate_hz);
+static DEVICE_ATTR_RW(ldm_sample_interval_ms);
+static DEVICE_ATTR_RW(ldm_max_duty_pct);
+static DEVICE_ATTR_RO(wake_last);
+static DEVICE_ATTR_RO(wake_counts);
 
 static struct attribute *faddev_sysfs_attrs[] = {
 	&dev_attr_standby_off_timer.attr,
@@ -308,6 +605,17 @@ static struct attribute *faddev_sysfs_attrs[] = {
 	&dev_attr_fadsuspend.attr,
 	&dev_attr_chargersuspend.attr,
 	&dev_attr_trigger_poll.attr,
+	&dev_attr_trigger_long_press_ms.attr,
+	&dev_attr_trigger_double_press_ms.attr,
+	&dev_attr_power_off_delay_ms.attr,
+	&dev_attr_timelapse_interval.attr,
+	&dev_attr_timelapse_window_ms.attr,
+	&dev_attr_backlight_instant_on.attr,
+	&dev_attr_ldm_max_rate_hz.attr,
+	&dev_attr_ldm_sample_interval_ms.attr,
+	&dev_attr_ldm_max_duty_pct.attr,
+	&dev_attr_wake_last.attr,
+	&dev_attr_wake_counts.attr,
 	NULL
 };
 
@@ -322,22 +630,23 @@ static struct attribute_group faddev_sysfs_attr_grp = {
  */
 int get_wake_reason(struct device *dev)
 {
+	struct faddata *data = dev_get_drvdata(dev);
 	struct wakeup_source *ws;
+	int reason;
 
 	ws = get_suspend_wakup_source();
 	if (!ws) {
 		dev_err(dev, "No suspend wakeup source\n");
+		fad_wake_count(data, UNKNOWN_WAKE);
 		return UNKNOWN_WAKE;
 	}
 	dev_dbg(dev, "Resume wakeup source '%s'\n", ws->name);
 
-	if (strstr(ws->name, "onkey"))
-		return ON_OFF_BUTTON_WAKE;
+	reason = fad_wake_classify(data, ws);
+	fad_wake_count(data, reason);
 
-	if (strstr(ws->name, "wake"))
-		return USB_CABLE_WAKE;
-
-	if (strstr(ws->name, "rtc")) {
+	switch (reason) {
+	case RTC_WAKE:
 		if (!standby_on_timer) {
 			dev_info(dev, "Poweroff after %lu min standby\n", standby_off_timer);
 			orderly_poweroff(1);
@@ -345,10 +654,26 @@ int get_wake_reason(struct device *dev)
 		}
 		dev_info(dev, "Wakeup after %lu min standby\n", standby_on_timer);
 		return ON_OFF_BUTTON_WAKE;
+
+	case UNKNOWN_WAKE:
+		dev_err(dev, "Unknown suspend wake reason '%s'\n", ws->name);
+		return UNKNOWN_WAKE;
+
+	default:
+		return reason;
 	}
+}
 
-	dev_err(dev, "Unknown suspend wake reason");
-	return UNKNOWN_WAKE;
+/**
+ * PM client acked standby or went away, called with pm_lock held
+ */
+static void fad_pm_client_done(struct faddata *data, struct fadclient *client)
+{
+	if (!client->bPmPending)
+		return;
+	client->bPmPending = FALSE;
+	data->pm_pending--;
+	wake_up(&data->pm_wq);
 }
 
 /**
@@ -357,6 +682,81 @@ int get_wake_reason(struct device *dev)
  */
 
 #ifdef CONFIG_OF
+static void fad_blank_backlight(struct faddata *data)
+{
+	if (data->pDev.backlight) {
+		data->pDev.backlight->props.power = FB_BLANK_POWERDOWN;
+		data->pDev.backlight->props.brightness = 0;
+		backlight_update_status(data->pDev.backlight);
+	}
+}
+
+/**
+ * Entering standby, remember backlight and blank it at once
+ */
+static void fad_backlight_save_blank(struct faddata *data)
+{
+	struct backlight_device *bl = data->pDev.backlight;
+
+	if (!bl || !data->bBacklightInstantOn)
+		return;
+	if (!data->bBacklightSaved) {
+		data->bl_power = bl->props.power;
+		data->bl_brightness = bl->props.brightness;
+		data->bBacklightSaved = TRUE;
+	}
+	fad_blank_backlight(data);
+}
+
+/**
+ * Restore backlight saved at standby
+ */
+static void fad_backlight_restore(struct faddata *data)
+{
+	struct backlight_device *bl = data->pDev.backlight;
+
+	if (!bl || !data->bBacklightSaved)
+		return;
+	data->bBacklightSaved = FALSE;
+	bl->props.power = data->bl_power;
+	bl->props.brightness = data->bl_brightness;
+	backlight_update_status(bl);
+}
+
+/**
+ * Check in resume if user is waiting for the display
+ */
+static BOOL fad_wake_interactive(struct faddata *data)
+{
+	switch (fad_wake_classify(data, get_suspend_wakup_source())) {
+	case ON_OFF_BUTTON_WAKE:
+	case INPUT_WAKE:
+		return TRUE;
+	case RTC_WAKE:
+		return standby_on_timer != 0;
+	default:
+		return FALSE;
+	}
+}
+
+/**
+ * Check in resume if the RTC alarm woke us only to power off: the
+ * standby power off alarm has fired, or the RTC woke us at its time.
+ * Allow one second early wakeup due to RTC resolution. Any other
+ * wake source near that time is a normal resume.
+ */
+static BOOL fad_standby_expired(struct faddata *data)
+{
+	s64 off_at = ktime_to_ns(data->standby_off_at);
+
+	if (!off_at || standby_on_timer)
+		return FALSE;
+	if (READ_ONCE(data->bStandbyTimeout))
+		return TRUE;
+	return fad_wake_classify(data, get_suspend_wakup_source()) == RTC_WAKE &&
+	       ktime_to_ns(ktime_get_real()) + NSEC_PER_SEC >= off_at;
+}
+
 /** Switch off camera after 6 hours in standby */
 enum alarmtimer_restart fad_standby_timeout(struct alarm *alarm, ktime_t kt)
 {
@@ -364,17 +764,140 @@ enum alarmtimer_restart fad_standby_timeout(struct alarm *alarm, ktime_t kt)
 	struct device *dev = data->dev;
 	
 	dev_dbg(dev, "Standby timeout, powering off");
+	WRITE_ONCE(data->bStandbyTimeout, TRUE);
 
 	// Switch of backlight as fast as possible (just activated in early resume)
-	if (data->pDev.backlight) {
-		data->pDev.backlight->props.power = 4;
-		data->pDev.backlight->props.brightness = 0;
-		backlight_update_status(data->pDev.backlight);
-	}
-	// Actual switch off will be done in get_wake_reason() when resume finished
+	fad_blank_backlight(data);
+	// Actual switch off is done at PM_POST_SUSPEND, usually already
+	// classified as dark resume in fad_resume()
 	return ALARMTIMER_NORESTART;
 }
 
+/**
+ * Check at PM_POST_SUSPEND if woken by the timelapse alarm
+ */
+static BOOL fad_timelapse_due(struct faddata *data)
+{
+	s64 wake_at = ktime_to_ns(data->timelapse_at);
+
+	if (!wake_at)
+		return FALSE;
+	return ktime_to_ns(ktime_get_real()) + NSEC_PER_SEC >= wake_at;
+}
+
+/**
+ * Leave standby, tell application we are running
+ */
+static void fad_notify_resumed(struct faddata *data)
+{
+	struct device *dev = data->dev;
+
+	if (data->wake_reason == USB_CABLE_WAKE)
+		fad_set_power_state(data, USB_CHARGE_STATE);
+	else
+		fad_set_power_state(data, ON_STATE);
+	fad_ldm_pause_sampling(FAD_LDM_PAUSE_SUSPEND, FALSE);
+
+	data->pDev.bSuspend = 0;
+	sysfs_notify(&dev->kobj, "control", "fadsuspend");
+	ApplicationEventRecord(&data->pDev, (power_state == USB_CHARGE_STATE) ?
+			       FAD_CHARGE_MODE_EVENT : FAD_RESUMED_EVENT,
+			       ktime_get(), data->wake_reason, 0);
+}
+
+/**
+ * Open a timelapse wake window, called with pm_lock held.
+ * Only the capture daemon runs, suspend is held off for the window.
+ */
+static void fad_timelapse_open(struct faddata *data)
+{
+	if (data->bTimelapseWindow)
+		return;
+	data->bTimelapseWindow = TRUE;
+	data->bTimelapseResuspend = FALSE;
+	__pm_stay_awake(data->timelapse_ws);
+	data->wake_reason = TIMELAPSE_WAKE;
+	ApplicationEventRecord(&data->pDev, FAD_TIMELAPSE_WAKE_EVENT,
+			       ktime_get(), ++data->timelapse_count, 0);
+	schedule_delayed_work(&data->timelapse_work, msecs_to_jiffies(timelapse_window));
+}
+
+/** Timelapse wake due, wakes the camera if suspended */
+static enum alarmtimer_restart fad_timelapse_alarm(struct alarm *alarm, ktime_t kt)
+{
+	struct faddata *data = container_of(alarm, struct faddata, alarm);
+
+	schedule_work(&data->timelapse_alarm_work);
+	return ALARMTIMER_NORESTART;
+}
+
+/**
+ * Timelapse alarm fired while awake between windows, nothing suspended
+ * the camera. Open the window anyway so the schedule goes on. After a
+ * suspend the window is opened at PM_POST_SUSPEND instead.
+ */
+static void fad_timelapse_alarm_work(struct work_struct *work)
+{
+	struct faddata *data = container_of(work, struct faddata, timelapse_alarm_work);
+
+	mutex_lock(&data->pm_lock);
+	if (data->bTimelapseResuspend)
+		fad_timelapse_open(data);
+	mutex_unlock(&data->pm_lock);
+}
+
+/**
+ * Timelapse wake window over (ack or timeout). The application stays
+ * in standby. Arm the alarm for the next wake, stop holding off
+ * suspend and let autosleep or the capture daemon suspend again,
+ * without a standby handshake.
+ */
+static void fad_timelapse_work(struct work_struct *work)
+{
+	struct faddata *data = container_of(to_delayed_work(work), struct faddata,
+					    timelapse_work);
+	ktime_t kt = ktime_set(timelapse_interval, 0);
+
+	mutex_lock(&data->pm_lock);
+	data->bTimelapseWindow = FALSE;
+	if (timelapse_interval) {
+		alarm_cancel(&data->alarm);
+		alarm_init(&data->alarm, ALARM_REALTIME, fad_timelapse_alarm);
+		data->timelapse_at = ktime_add(ktime_get_real(), kt);
+		alarm_start_relative(&data->alarm, kt);
+		data->bTimelapseResuspend = TRUE;
+	}
+	mutex_unlock(&data->pm_lock);
+	__pm_relax(data->timelapse_ws);
+}
+
+/**
+ * Timelapse capture done
+ *
+ * @param data
+ * @param resuspend TRUE to allow suspend now, FALSE to stay awake
+ *
+ * @return 0, -EINVAL if not in a timelapse wake window
+ */
+static int fad_timelapse_ack(struct faddata *data, BOOL resuspend)
+{
+	if (!cancel_delayed_work(&data->timelapse_work))
+		return -EINVAL;
+
+	if (resuspend) {
+		schedule_delayed_work(&data->timelapse_work, 0);
+	} else {
+		mutex_lock(&data->pm_lock);
+		data->bTimelapseWindow = FALSE;
+		mutex_unlock(&data->pm_lock);
+		data->wake_reason = ON_OFF_BUTTON_WAKE;
+		fad_backlight_restore(data);
+		fad_notify_resumed(data);
+		__pm_relax(data->timelapse_ws);
+	}
+	return 0;
+}
+
 /** Wake up camera after 1 minute in (timed) standby */
 enum alarmtimer_restart fad_standby_wakeup(struct alarm *alarm, ktime_t kt)
 {
@@ -385,55 +908,172 @@ enum alarmtimer_restart fad_standby_wakeup(struct alarm *alarm, ktime_t kt)
 	return ALARMTIMER_NORESTART;
 }
 
+/**
+ * Wait for a standby ack until start + timeout
+ *
+ * @return true if acked
+ */
+static bool fad_wait_ack(struct completion *ack, unsigned long start,
+			 unsigned int timeout_ms)
+{
+	long remaining = (long)(start + msecs_to_jiffies(timeout_ms) - jiffies);
+
+	if (remaining <= 0)
+		return try_wait_for_completion(ack);
+	return wait_for_completion_timeout(ack, remaining) != 0;
+}
+
+/**
+ * Wait until every PM client has acked standby or passed its deadline.
+ * pm_lock is only held while scanning, clients may ack, close or
+ * register while we wait.
+ */
+static void fad_wait_pm_clients(struct faddata *data)
+{
+	struct fadclient *client;
+	long wait;
+
+	for (;;) {
+		wait = 0;
+		mutex_lock(&data->pm_lock);
+		list_for_each_entry(client, &data->pm_clients, pm_node) {
+			long left;
+
+			if (!client->bPmPending)
+				continue;
+			left = (long)(client->pmDeadline - jiffies);
+			if (left <= 0) {
+				dev_err(data->dev, "PM client '%s' no standby ack within %u ms\n",
+					client->pmName, client->pmTimeoutMs);
+				fad_pm_client_done(data, client);
+			} else if (!wait || left < wait) {
+				wait = left;
+			}
+		}
+		mutex_unlock(&data->pm_lock);
+		if (!wait)
+			return;
+		wait_event_timeout(data->pm_wq, !READ_ONCE(data->pm_pending), wait);
+	}
+}
+
 static int fad_notify(struct notifier_block *nb, unsigned long val, void *ign)
 {
 	ktime_t kt;
 	void *alarm_wakeup_func;
-	unsigned long jifs;
+	unsigned long start;
+	struct fadclient *client;
 	struct faddata *data = container_of(nb, struct faddata, nb);
 	struct device *dev = data->dev;
+	BOOL bResuspend;
 
 	switch (val) {
 	case PM_SUSPEND_PREPARE:
-		// Make appcore enter standby
-		power_state = SUSPEND_STATE;
-		data->pDev.bSuspend = 1;
-		sysfs_notify(&dev->kobj, "control", "fadsuspend");
+		fad_pm_mark(data, FAD_PM_PREPARE);
+		fad_backlight_save_blank(data);
+		// Resumed when leaving standby, not at timelapse wakes
+		fad_ldm_pause_sampling(FAD_LDM_PAUSE_SUSPEND, TRUE);
+		data->bDarkResume = FALSE;
+		WRITE_ONCE(data->bStandbyTimeout, FALSE);
+
+		// Application already in standby between timelapse windows,
+		// alarm armed when the window closed
+		mutex_lock(&data->pm_lock);
+		bResuspend = data->bTimelapseResuspend || data->bTimelapseWindow;
+		data->bTimelapseResuspend = FALSE;
+		mutex_unlock(&data->pm_lock);
+		if (bResuspend && timelapse_interval) {
+			fad_pm_mark(data, FAD_PM_ACKED);
+			fad_pm_mark(data, FAD_PM_ALARM);
+			return NOTIFY_OK;
+		}
 
-		if (standby_on_timer) {
+		if (timelapse_interval) {
+			alarm_wakeup_func = fad_timelapse_alarm;
+			kt = ktime_set(timelapse_interval, 0);
+			data->timelapse_at = ktime_add(ktime_get_real(), kt);
+			data->standby_off_at = ktime_set(0, 0);
+		} else if (standby_on_timer) {
 			alarm_wakeup_func = fad_standby_wakeup;
 			kt = ktime_set(60 * standby_on_timer, 0);
+			data->timelapse_at = ktime_set(0, 0);
+			data->standby_off_at = ktime_set(0, 0);
 		} else {
 			alarm_wakeup_func = fad_standby_timeout;
 			kt = ktime_set(60 * standby_off_timer, 0);
+			data->timelapse_at = ktime_set(0, 0);
+			data->standby_off_at = ktime_set(0, 0);
+		}
+		dev_dbg(dev, "SUSPEND %lu s\n", (long)ktime_divns(kt, NSEC_PER_SEC));
+
+		// Make appcore and registered clients enter standby
+		start = jiffies;
+		mutex_lock(&data->pm_lock);
+		list_for_each_entry(client, &data->pm_clients, pm_node) {
+			if (!client->bPmPending)
+				data->pm_pending++;
+			client->bPmPending = TRUE;
+			client->pmDeadline = start + msecs_to_jiffies(client->pmTimeoutMs);
 		}
-		dev_dbg(dev, "SUSPEND %lu min\n", (long)ktime_divns(kt, NSEC_PER_SEC) / 60);
+		mutex_unlock(&data->pm_lock);
+		reinit_completion(&data->pDev.standbyComplete);
+		power_state = SUSPEND_STATE;
+		data->pDev.bSuspend = 1;
+		sysfs_notify(&dev->kobj, "control", "fadsuspend");
+		ApplicationEventRecord(&data->pDev, FAD_SUSPEND_PREPARE_EVENT,
+				       ktime_get(), 0, 0);
 
 		// Wait for appcore
-		jifs = wait_for_completion_timeout(&data->pDev.standbyComplete,
-						   msecs_to_jiffies(10000));
-		if (!jifs)
-			dev_dbg(dev, "Timeout waiting for standby completion\n");
-
-		if (data->pDev.bSuspend) {
-			dev_err(dev, "Application suspend failed\n");
-			//  return NOTIFY_BAD;
+		if (standby_ack_timeout) {
+			if (!fad_wait_ack(&data->pDev.standbyComplete, start,
+					  standby_ack_timeout))
+				dev_dbg(dev, "Timeout waiting for standby completion\n");
+
+			if (data->pDev.bSuspend) {
+				dev_err(dev, "Application suspend failed\n");
+				//  return NOTIFY_BAD;
+			}
 		}
 
+		// All clients were notified at start, each has its own deadline
+		fad_wait_pm_clients(data);
+		fad_pm_mark(data, FAD_PM_ACKED);
+
+		alarm_cancel(&data->alarm);
 		alarm_init(&data->alarm, ALARM_REALTIME, alarm_wakeup_func);
 		alarm_start_relative(&data->alarm, kt);
+		// From when the alarm runs, the ack wait above may be long
+		if (!timelapse_interval && !standby_on_timer)
+			data->standby_off_at = ktime_add(ktime_get_real(), kt);
+		fad_pm_mark(data, FAD_PM_ALARM);
 		return NOTIFY_OK;
 
 	case PM_POST_SUSPEND:
 		dev_dbg(dev, "POST_SUSPEND\n");
-		if (get_wake_reason(dev) == USB_CABLE_WAKE)
-			power_state = USB_CHARGE_STATE;
-		else
-			power_state = ON_STATE;
-
-		data->pDev.bSuspend = 0;
+		fad_pm_mark(data, FAD_PM_POST_SUSPEND);
+		// Alarm may fire after fad_resume() if the RTC woke us early
+		if (data->bDarkResume || READ_ONCE(data->bStandbyTimeout)) {
+			// Application stays in standby, not notified
+			dev_info(dev, "Poweroff after %lu min standby\n", standby_off_timer);
+			fad_wake_count(data, RTC_WAKE);
+			fad_pm_mark(data, FAD_PM_WAKE_REASON);
+			orderly_poweroff(1);
+			return NOTIFY_OK;
+		}
 		alarm_cancel(&data->alarm);
-		sysfs_notify(&dev->kobj, "control", "fadsuspend");
+		if (fad_timelapse_due(data)) {
+			fad_wake_count(data, TIMELAPSE_WAKE);
+			fad_pm_mark(data, FAD_PM_WAKE_REASON);
+			mutex_lock(&data->pm_lock);
+			fad_timelapse_open(data);
+			mutex_unlock(&data->pm_lock);
+			return NOTIFY_OK;
+		}
+		data->wake_reason = get_wake_reason(dev);
+		fad_pm_mark(data, FAD_PM_WAKE_REASON);
+		// Not restored in fad_resume, e.g. aborted suspend. In charge
+		// mode it is restored when leaving, see fad_set_power_state()
+		fad_notify_resumed(data);
 		return NOTIFY_OK;
 	}
 	return NOTIFY_DONE;
@@ -443,6 +1083,10 @@ static int fad_notify(struct notifier_block *nb, unsigned long val, void *ign)
 static int fad_probe(struct platform_device *pdev)
 {
 	int ret;
+	int autosuspend_delay;
+#ifdef CONFIG_OF
+	u32 val;
+#endif
 	struct device *dev = &pdev->dev;
 	struct faddata *data;
 
@@ -460,24 +1104,65 @@ static int fad_probe(struct platform_device *pdev)
 	dev_set_drvdata(dev, data);
 	platform_set_drvdata(pdev, data);
 
-	ret = misc_register(&data->miscdev);
-	if (ret) {
-		dev_err(dev, "Failed to register miscdev for FAD driver\n");
-		goto exit;
-	}
 	// initialize this device instance
 	sema_init(&data->pDev.semDevice, 1);
+	mutex_init(&data->pDev.laserLock);
 
-	// init wait queue
+	// init wait queue and event clients
 	init_waitqueue_head(&data->pDev.wq);
-
-	// Set up CPU specific stuff
+	spin_lock_init(&data->pDev.clientLock);
+	INIT_LIST_HEAD(&data->pDev.clients);
+	spin_lock_init(&data->pDev.trigger.lock);
+	mutex_init(&data->pm_lock);
+	INIT_LIST_HEAD(&data->pm_clients);
+	init_waitqueue_head(&data->pm_wq);
+	spin_lock_init(&data->pDev.loadLock);
+	INIT_LIST_HEAD(&data->pDev.power_domains);
+	fad_led_init(&data->pDev);
+	fad_kp_init(&data->pDev);
+
+	// Set up CPU specific stuff, may defer until LEDs and regulators
+	// are bound, so before anything is visible to userspace
 	ret = cpu_initialize(dev);
 	if (ret < 0) {
-		dev_err(dev, "flirdrv-fad: Failed to initialize CPU\n");
-		goto exit_cpuinitialize;
+		if (ret != -EPROBE_DEFER)
+			dev_err(dev, "flirdrv-fad: Failed to initialize CPU\n");
+		goto exit;
 	}
 
+	data->debugfs = debugfs_create_dir("fad", NULL);
+	fad_pm_init(data);
+	fad_power_init(data);
+	fad_stats_init(data);
+
+	ret = misc_register(&data->miscdev);
+	if (ret) {
+		dev_err(dev, "Failed to register miscdev for FAD driver\n");
+		goto exit_misc_register;
+	}
+
+	// Rails are on after setup, autosuspend only when a delay is configured
+	autosuspend_delay = -1;
+#ifdef CONFIG_OF
+	if (!of_property_read_u32(dev->of_node, "autosuspend-delay-ms", &val))
+		autosuspend_delay = val;
+	data->bBacklightInstantOn = of_property_read_bool(dev->of_node,
+							  "backlight-instant-on");
+#endif
+	pm_runtime_set_autosuspend_delay(dev, autosuspend_delay);
+	pm_runtime_use_autosuspend(dev);
+	pm_runtime_set_active(dev);
+	pm_runtime_enable(dev);
+	pm_runtime_mark_last_busy(dev);
+	pm_request_autosuspend(dev);
+
+	ret = InitIrqWake(&data->pDev);
+	if (ret) {
+		dev_err(dev, "Failed to register input wakeup source\n");
+		goto exit_irq_wake;
+	}
+	fad_wake_init(data);
+
 	ret = sysfs_create_group(&dev->kobj, &faddev_sysfs_attr_grp);
 	if (ret) {
 		dev_err(dev, "FADDEV Error creating sysfs grp control\n");
@@ -485,6 +1170,17 @@ static int fad_probe(struct platform_device *pdev)
 	}
 
 #ifdef CONFIG_OF
+	INIT_DELAYED_WORK(&data->timelapse_work, fad_timelapse_work);
+	INIT_WORK(&data->timelapse_alarm_work, fad_timelapse_alarm_work);
+	alarm_init(&data->alarm, ALARM_REALTIME, fad_standby_wakeup);
+	fad_timelapse_check(dev);
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5,4,0)
+	data->timelapse_ws = wakeup_source_register("fad-timelapse");
+#else
+	data->timelapse_ws = wakeup_source_register(dev, "fad-timelapse");
+#endif
+	if (!data->timelapse_ws)
+		dev_warn(dev, "No timelapse wakeup source, window not held awake\n");
 	data->nb.notifier_call = fad_notify;
 	data->nb.priority = 0;
 	ret = register_pm_notifier(&data->nb);
@@ -499,16 +1195,47 @@ static int fad_probe(struct platform_device *pdev)
 #ifdef CONFIG_OF
 	unregister_pm_notifier(&data->nb);
 exit_register_pm_notifier:
+	wakeup_source_unregister(data->timelapse_ws);
 #endif
 	sysfs_remove_group(&dev->kobj, &faddev_sysfs_attr_grp);
 exit_sysfs_create_group:
-	cpu_deinitialize(dev);
-exit_cpuinitialize:
+	FreeIrqWake(&data->pDev);
+exit_irq_wake:
+	pm_runtime_disable(dev);
+	pm_runtime_dont_use_autosuspend(dev);
 	misc_deregister(&data->miscdev);
+exit_misc_register:
+	debugfs_remove_recursive(data->debugfs);
+	fad_led_exit(&data->pDev);
+	fad_kp_exit(&data->pDev);
+	cpu_deinitialize(dev);
 exit:
 	return ret;
 }
 
+/**
+ * Hold the rails while the laser is active or the motor is powered,
+ * not just for the ioctl that turned them on. Called under semDevice
+ * from an ioctl already holding a runtime PM reference.
+ *
+ * @param data
+ * @param held  bLaserRuntime or bMotorRuntime
+ * @param on
+ */
+static void fad_runtime_hold(struct faddata *data, BOOL *held, BOOL on)
+{
+	on = !!on;
+	if (on == *held)
+		return;
+	*held = on;
+	if (on) {
+		pm_runtime_get_noresume(data->dev);
+	} else {
+		pm_runtime_mark_last_busy(data->dev);
+		pm_runtime_put_autosuspend(data->dev);
+	}
+}
+
 static int fad_remove(struct platform_device *pdev)
 {
 	struct device *dev = &pdev->dev;
@@ -517,31 +1244,93 @@ static int fad_remove(struct platform_device *pdev)
 	dev_dbg(&pdev->dev, "Removing FAD driver\n");
 #ifdef CONFIG_OF
 	unregister_pm_notifier(&data->nb);
+	// Window may arm the alarm, the alarm may open a window
+	cancel_delayed_work_sync(&data->timelapse_work);
+	mutex_lock(&data->pm_lock);
+	data->bTimelapseResuspend = FALSE;
+	mutex_unlock(&data->pm_lock);
+	cancel_work_sync(&data->timelapse_alarm_work);
+	cancel_delayed_work_sync(&data->timelapse_work);
+	alarm_cancel(&data->alarm);
+	wakeup_source_unregister(data->timelapse_ws);
 #endif
 	sysfs_remove_group(&dev->kobj, &faddev_sysfs_attr_grp);
-	cpu_deinitialize(dev);
+	FreeIrqWake(&data->pDev);
+	fad_runtime_hold(data, &data->bLaserRuntime, FALSE);
+	fad_runtime_hold(data, &data->bMotorRuntime, FALSE);
+	pm_runtime_disable(dev);
+	pm_runtime_dont_use_autosuspend(dev);
 	misc_deregister(&data->miscdev);
+	debugfs_remove_recursive(data->debugfs);
+	fad_led_exit(&data->pDev);
+	fad_kp_exit(&data->pDev);
+	cpu_deinitialize(dev);
 	return 0;
 }
 
-static int fad_suspend(struct platform_device *pdev, pm_message_t state)
+static int __maybe_unused fad_suspend(struct device *dev)
 {
-	struct faddata *data = platform_get_drvdata(pdev);
+	struct faddata *data = dev_get_drvdata(dev);
 
+	fad_pm_mark(data, FAD_PM_SUSPEND);
+	// Keypad LEDs may sit on I2C, no fade ticks once suspended
+	fad_kp_fade_stop(&data->pDev);
 	if (data->pDev.suspend)
 		data->pDev.suspend(&data->pDev);
+	SetIrqWake(&data->pDev, TRUE);
+	fad_pm_mark(data, FAD_PM_SUSPENDED);
 	return 0;
 }
 
-static int fad_resume(struct platform_device *pdev)
+static int __maybe_unused fad_resume(struct device *dev)
 {
-	struct faddata *data = platform_get_drvdata(pdev);
+	struct faddata *data = dev_get_drvdata(dev);
 
+	fad_pm_mark(data, FAD_PM_RESUME);
+	SetIrqWake(&data->pDev, FALSE);
+#ifdef CONFIG_OF
+	// Standby power off, leave rails and backlight off
+	if (fad_standby_expired(data)) {
+		data->bDarkResume = TRUE;
+		fad_blank_backlight(data);
+		fad_pm_mark(data, FAD_PM_RESUMED);
+		return 0;
+	}
+	// Display on before userspace thaws
+	if (!fad_timelapse_due(data) && fad_wake_interactive(data))
+		fad_backlight_restore(data);
+#endif
 	if (data->pDev.resume)
 		data->pDev.resume(&data->pDev);
+	fad_pm_mark(data, FAD_PM_RESUMED);
+	return 0;
+}
+
+static int __maybe_unused fad_runtime_suspend(struct device *dev)
+{
+	struct faddata *data = dev_get_drvdata(dev);
+
+	dev_dbg(dev, "Runtime suspend\n");
+	if (data->pDev.runtime_suspend)
+		return data->pDev.runtime_suspend(&data->pDev);
+	return 0;
+}
+
+static int __maybe_unused fad_runtime_resume(struct device *dev)
+{
+	struct faddata *data = dev_get_drvdata(dev);
+
+	dev_dbg(dev, "Runtime resume\n");
+	if (data->pDev.runtime_resume)
+		return data->pDev.runtime_resume(&data->pDev);
 	return 0;
 }
 
+static const struct dev_pm_ops fad_pm_ops = {
+	SET_SYSTEM_SLEEP_PM_OPS(fad_suspend, fad_resume)
+	SET_RUNTIME_PM_OPS(fad_runtime_suspend, fad_runtime_resume, NULL)
+};
+
 static void fad_shutdown(struct platform_device *pdev)
 {
 	struct faddata *data = platform_get_drvdata(pdev);
@@ -553,12 +1342,11 @@ static void fad_shutdown(struct platform_device *pdev)
 static struct platform_driver fad_driver = {
 	.probe = fad_probe,
 	.remove = fad_remove,
-	.suspend = fad_suspend,
-	.resume = fad_resume,
 	.shutdown = fad_shutdown,
 	.driver = {
 		   .name = "fad",
 		   .owner = THIS_MODULE,
+		   .pm = &fad_pm_ops,
 		    },
 };
 
@@ -566,9 +1354,10 @@ static struct platform_driver fad_driver = {
  * DOIOControl
  *
  */
-static int DoIOControl(struct device *dev, DWORD Ioctl, PUCHAR pBuf, PUCHAR pUserBuf)
+static int DoIOControl(struct fadclient *client, DWORD Ioctl, PUCHAR pBuf, PUCHAR pUserBuf)
 {
-	struct faddata *data = dev_get_drvdata(dev);
+	struct faddata *data = client->data;
+	struct device *dev = data->dev;
 	static BOOL bGPSEnable = FALSE;
 	int retval;
 
@@ -578,8 +1367,8 @@ static int DoIOControl(struct device *dev, DWORD Ioctl, PUCHAR pBuf, PUCHAR pUse
 			retval = ERROR_NOT_SUPPORTED;
 		else {
 			down(&data->pDev.semDevice);
-			data->pDev.bLaserEnable = ((PFADDEVIOCTLLASER) pBuf)->bLaserPowerEnabled;
-			data->pDev.pSetLaserStatus(&data->pDev, data->pDev.bLaserEnable);
+			data->pDev.pSetLaserStatus(&data->pDev,
+					((PFADDEVIOCTLLASER) pBuf)->bLaserPowerEnabled);
 			retval = ERROR_SUCCESS;
 			up(&data->pDev.semDevice);
 		}
@@ -620,6 +1409,8 @@ static int DoIOControl(struct device *dev, DWORD Ioctl, PUCHAR pBuf, PUCHAR pUse
 				// Activate sound
 				data->pDev.pSetBuzzerFrequency(pBuzzerData->usFreq,
 							   pBuzzerData->ucPWM);
+				fad_load_set(&data->pDev, FAD_LOAD_BUZZER,
+					     pBuzzerData->usFreq != 0);
 			}
 			if (pBuzzerData->eState == BUZZER_TIME) {
 				up(&data->pDev.semDevice);
@@ -629,6 +1420,7 @@ static int DoIOControl(struct device *dev, DWORD Ioctl, PUCHAR pBuf, PUCHAR pUse
 			if ((pBuzzerData->eState == BUZZER_OFF) || 
 			    (pBuzzerData->eState == BUZZER_TIME)) {
 				data->pDev.pSetBuzzerFrequency(0, 0); // Switch off sound
+				fad_load_set(&data->pDev, FAD_LOAD_BUZZER, FALSE);
 			}
 			up(&data->pDev.semDevice);
 			retval = ERROR_SUCCESS;
@@ -690,6 +1482,32 @@ static int DoIOControl(struct device *dev, DWORD Ioctl, PUCHAR pBuf, PUCHAR pUse
 		}
 		break;
 
+	case IOCTL_FAD_SET_LED_PATTERN:
+		if (!data->pDev.bHasKAKALed)
+			retval = ERROR_NOT_SUPPORTED;
+		else {
+			down(&data->pDev.semDevice);
+			if (fad_led_set_pattern(&data->pDev, (PFADDEVIOCTLLEDPATTERN) pBuf))
+				retval = ERROR_INVALID_PARAMETER;
+			else
+				retval = ERROR_SUCCESS;
+			up(&data->pDev.semDevice);
+		}
+		break;
+
+	case IOCTL_FAD_START_LED_PATTERN:
+		if (!data->pDev.bHasKAKALed)
+			retval = ERROR_NOT_SUPPORTED;
+		else {
+			down(&data->pDev.semDevice);
+			if (fad_led_start_id(&data->pDev, *(DWORD *) pBuf))
+				retval = ERROR_INVALID_PARAMETER;
+			else
+				retval = ERROR_SUCCESS;
+			up(&data->pDev.semDevice);
+		}
+		break;
+
 	case IOCTL_FAD_SET_GPS_ENABLE:
 		if (!data->pDev.bHasGPS)
 			retval = ERROR_NOT_SUPPORTED;
@@ -717,10 +1535,11 @@ static int DoIOControl(struct device *dev, DWORD Ioctl, PUCHAR pBuf, PUCHAR pUse
 		if (!data->pDev.bHasLaser)
 			retval = ERROR_NOT_SUPPORTED;
 		else {
+			BOOL on = ((FADDEVIOCTLLASERACTIVE *) pBuf)->bLaserActive == TRUE;
+
 			down(&data->pDev.semDevice);
-			data->pDev.pSetLaserActive(&data->pDev,
-						   ((FADDEVIOCTLLASERACTIVE *)
-						    pBuf)->bLaserActive == TRUE);
+			data->pDev.pSetLaserActive(&data->pDev, on);
+			fad_runtime_hold(data, &data->bLaserRuntime, on);
 			retval = ERROR_SUCCESS;
 			up(&data->pDev.semDevice);
 		}
@@ -738,6 +1557,23 @@ static int DoIOControl(struct device *dev, DWORD Ioctl, PUCHAR pBuf, PUCHAR pUse
 		}
 		break;
 
+	case IOCTL_FAD_SET_FOCUS_MOTOR:
+		if (!data->pDev.bHasFocusModule || !data->pDev.pSetFocusMotor)
+			retval = ERROR_NOT_SUPPORTED;
+		else {
+			BOOL on = ((PFADDEVIOCTLFOCUSMOTOR) pBuf)->bMotorPowered;
+
+			down(&data->pDev.semDevice);
+			// Regulator errno, like a failed runtime resume in FAD_IOControl()
+			retval = data->pDev.pSetFocusMotor(&data->pDev, on);
+			if (!retval) {
+				fad_runtime_hold(data, &data->bMotorRuntime, on);
+				retval = ERROR_SUCCESS;
+			}
+			up(&data->pDev.semDevice);
+		}
+		break;
+
 	case IOCTL_FAD_GET_HDMI_STATUS:
 		retval = ERROR_NOT_SUPPORTED;
 		break;
@@ -784,6 +1620,36 @@ static int DoIOControl(struct device *dev, DWORD Ioctl, PUCHAR pBuf, PUCHAR pUse
 		}
 		break;
 
+	case IOCTL_FAD_GET_KP_STEP:
+		if (!data->pDev.bHasKpBacklight || !data->pDev.pGetKeypadLevel)
+			retval = ERROR_NOT_SUPPORTED;
+		else {
+			PFADDEVIOCTLKPSTEP pStep = (PFADDEVIOCTLKPSTEP) pBuf;
+
+			pStep->ulStep = fad_kp_brightness_to_step(&data->pDev,
+					data->pDev.pGetKeypadLevel(&data->pDev));
+			pStep->ulSteps = data->pDev.kpNumLevels;
+			retval = ERROR_SUCCESS;
+		}
+		break;
+
+	case IOCTL_FAD_SET_KP_STEP:
+		if (!data->pDev.bHasKpBacklight || !data->pDev.pSetKeypadLevel)
+			retval = ERROR_NOT_SUPPORTED;
+		else {
+			int brightness = fad_kp_step_to_brightness(&data->pDev,
+					((PFADDEVIOCTLKPSTEP) pBuf)->ulStep);
+
+			if (brightness < 0) {
+				retval = ERROR_INVALID_PARAMETER;
+			} else {
+				fad_kp_fade_stop(&data->pDev);
+				data->pDev.pSetKeypadLevel(&data->pDev, brightness);
+				retval = ERROR_SUCCESS;
+			}
+		}
+		break;
+
 	case IOCTL_FAD_GET_START_REASON:
 		memcpy(pBuf, &g_RestartReason, sizeof(DWORD));
 		retval = ERROR_SUCCESS;
@@ -803,8 +1669,77 @@ static int DoIOControl(struct device *dev, DWORD Ioctl, PUCHAR pBuf, PUCHAR pUse
 		break;
 
 	case IOCTL_FAD_RELEASE_READ:
-		data->pDev.eEvent = FAD_RESET_EVENT;
-		wake_up_interruptible(&data->pDev.wq);
+		ApplicationEvent(&data->pDev, FAD_RESET_EVENT);
+		retval = ERROR_SUCCESS;
+		break;
+
+	case IOCTL_FAD_GET_TRIG_PRESSED:
+		if (!data->pDev.bHasTrigger)
+			retval = ERROR_NOT_SUPPORTED;
+		else {
+			((PFADDEVIOCTLTRIGPRESSED) pBuf)->bTrigPressed =
+				READ_ONCE(data->pDev.trigger.bPressed);
+			retval = ERROR_SUCCESS;
+		}
+		break;
+
+	case IOCTL_FAD_SUSPEND_ACK:
+		if (client->pmTimeoutMs) {
+			mutex_lock(&data->pm_lock);
+			if (client->bPmPending && *(DWORD *) pBuf == 0)
+				dev_err(dev, "PM client '%s' standby prepare failed\n",
+					client->pmName);
+			fad_pm_client_done(data, client);
+			mutex_unlock(&data->pm_lock);
+		} else
+			fad_suspend_ack(data, *(DWORD *) pBuf != 0);
+		retval = ERROR_SUCCESS;
+		break;
+
+	case IOCTL_FAD_GET_LOAD_STATS:
+		fad_load_snapshot(&data->pDev, (PFADDEVIOCTLLOADSTATS) pBuf);
+		retval = ERROR_SUCCESS;
+		break;
+
+	case IOCTL_FAD_TIMELAPSE_ACK:
+#ifdef CONFIG_OF
+		if (fad_timelapse_ack(data, *(DWORD *) pBuf != 0))
+			retval = ERROR_INVALID_PARAMETER;
+		else
+			retval = ERROR_SUCCESS;
+#else
+		retval = ERROR_NOT_SUPPORTED;
+#endif
+		break;
+
+	case IOCTL_FAD_REGISTER_PM_CLIENT:
+		{
+			PFADDEVIOCTLPMCLIENT pClient = (PFADDEVIOCTLPMCLIENT) pBuf;
+
+			mutex_lock(&data->pm_lock);
+			fad_pm_client_done(data, client);
+			if (client->pmTimeoutMs)
+				list_del(&client->pm_node);
+			memcpy(client->pmName, pClient->szName, sizeof(client->pmName) - 1);
+			client->pmName[sizeof(client->pmName) - 1] = '\0';
+			client->pmTimeoutMs = pClient->ulTimeoutMs;
+			if (client->pmTimeoutMs)
+				list_add_tail(&client->pm_node, &data->pm_clients);
+			mutex_unlock(&data->pm_lock);
+		}
+		retval = ERROR_SUCCESS;
+		break;
+
+	case IOCTL_FAD_SET_EVENT_RECORDS:
+		{
+			unsigned long flags;
+
+			spin_lock_irqsave(&data->pDev.clientLock, flags);
+			client->bRecords = (*(DWORD *) pBuf != 0);
+			kfifo_reset(&client->events);
+			spin_unlock_irqrestore(&data->pDev.clientLock, flags);
+		}
+		retval = ERROR_SUCCESS;
 		break;
 
 	default:
@@ -817,6 +1752,25 @@ static int DoIOControl(struct device *dev, DWORD Ioctl, PUCHAR pBuf, PUCHAR pUse
 	return retval;
 }
 
+/**
+ * Focus and laser ioctls need the optics and sensor rails,
+ * these hold a runtime PM reference while executing.
+ */
+static BOOL fad_ioctl_needs_rails(unsigned int cmd)
+{
+	switch (cmd) {
+	case IOCTL_FAD_SET_LASER_STATUS:
+	case IOCTL_FAD_GET_LASER_STATUS:
+	case IOCTL_FAD_SET_LASER_MODE:
+	case IOCTL_FAD_SET_LASER_ACTIVE:
+	case IOCTL_FAD_GET_LASER_ACTIVE:
+	case IOCTL_FAD_SET_FOCUS_MOTOR:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
 /**
  * FAD_IOControl
  *
@@ -828,12 +1782,24 @@ static int DoIOControl(struct device *dev, DWORD Ioctl, PUCHAR pBuf, PUCHAR pUse
  */
 static long FAD_IOControl(struct file *filep, unsigned int cmd, unsigned long arg)
 {
-	struct faddata *data = container_of(filep->private_data, struct faddata, miscdev);
+	struct fadclient *client = filep->private_data;
+	struct faddata *data = client->data;
 	struct device *dev = data->dev;
+	BOOL bRuntime = fad_ioctl_needs_rails(cmd);
 
 	int retval = ERROR_SUCCESS;
 	char *tmp;
 
+	if (bRuntime) {
+		retval = pm_runtime_get_sync(dev);
+		if (retval < 0) {
+			dev_err(dev, "Ioctl %X runtime resume failed: %d\n", cmd, retval);
+			pm_runtime_put_noidle(dev);
+			return retval;
+		}
+		retval = ERROR_SUCCESS;
+	}
+
 	tmp = kzalloc(_IOC_SIZE(cmd), GFP_KERNEL);
 	if (_IOC_DIR(cmd) & _IOC_WRITE) {
 		dev_dbg(dev, "Ioctl %X copy from user: %d\n", cmd, _IOC_SIZE(cmd));
@@ -844,7 +1810,7 @@ static long FAD_IOControl(struct file *filep, unsigned int cmd, unsigned long ar
 
 	if (retval == ERROR_SUCCESS) {
 		dev_dbg(dev, "Ioctl %X\n", cmd);
-		retval = DoIOControl(data->dev, cmd, tmp, (PUCHAR) arg);
+		retval = DoIOControl(client, cmd, tmp, (PUCHAR) arg);
 		if (retval && (retval != ERROR_NOT_SUPPORTED))
 			dev_err(dev, "Ioctl failed: %X %i %d\n", cmd, retval, _IOC_NR(cmd));
 	}
@@ -857,9 +1823,82 @@ static long FAD_IOControl(struct file *filep, unsigned int cmd, unsigned long ar
 	}
 	kfree(tmp);
 
+	if (bRuntime) {
+		pm_runtime_mark_last_busy(dev);
+		pm_runtime_put_autosuspend(dev);
+	}
+
 	return retval;
 }
 
+/**
+ * FadOpen
+ *
+ * Allocate per file client, initially reading legacy single byte events
+ *
+ * @param inode
+ * @param filep
+ *
+ * @return
+ */
+static int FadOpen(struct inode *inode, struct file *filep)
+{
+	struct faddata *data = container_of(filep->private_data, struct faddata, miscdev);
+	struct fadclient *client;
+	unsigned long flags;
+
+	client = kzalloc(sizeof(*client), GFP_KERNEL);
+	if (!client)
+		return -ENOMEM;
+
+	client->data = data;
+	INIT_KFIFO(client->events);
+
+	spin_lock_irqsave(&data->pDev.clientLock, flags);
+	list_add_tail(&client->node, &data->pDev.clients);
+	spin_unlock_irqrestore(&data->pDev.clientLock, flags);
+
+	filep->private_data = client;
+	return 0;
+}
+
+/**
+ * FadRelease
+ *
+ * @param inode
+ * @param filep
+ *
+ * @return
+ */
+static int FadRelease(struct inode *inode, struct file *filep)
+{
+	struct fadclient *client = filep->private_data;
+	struct faddata *data = client->data;
+	unsigned long flags;
+
+	mutex_lock(&data->pm_lock);
+	fad_pm_client_done(data, client);
+	if (client->pmTimeoutMs)
+		list_del(&client->pm_node);
+	mutex_unlock(&data->pm_lock);
+
+	spin_lock_irqsave(&data->pDev.clientLock, flags);
+	while (client->wakeUnread)
+		RelaxIrqWake(&data->pDev, client);
+	list_del(&client->node);
+	spin_unlock_irqrestore(&data->pDev.clientLock, flags);
+
+	kfree(client);
+	return 0;
+}
+
+static BOOL FadClientHasEvent(struct fadclient *client)
+{
+	if (client->bRecords)
+		return !kfifo_is_empty(&client->events);
+	return client->data->pDev.eEvent != FAD_NO_EVENT;
+}
+
 /**
  * FADPoll
  *
@@ -870,10 +1909,50 @@ static long FAD_IOControl(struct file *filep, unsigned int cmd, unsigned long ar
  */
 static unsigned int FadPoll(struct file *filep, poll_table *pt)
 {
-	struct faddata *data = container_of(filep->private_data, struct faddata, miscdev);
+	struct fadclient *client = filep->private_data;
+	struct faddata *data = client->data;
 
 	poll_wait(filep, &data->pDev.wq, pt);
-	return (data->pDev.eEvent != FAD_NO_EVENT) ? (POLLIN | POLLRDNORM) : 0;
+	return FadClientHasEvent(client) ? (POLLIN | POLLRDNORM) : 0;
+}
+
+/**
+ * FadReadRecords
+ *
+ * Read as many whole FADDEVEVENT records as available and fit in buf
+ *
+ * @return bytes read
+ */
+static ssize_t FadReadRecords(struct fadclient *client, char __user *buf, size_t count,
+			      BOOL nonblock)
+{
+	struct faddata *data = client->data;
+	FADDEVEVENT rec;
+	size_t read = 0;
+	int res;
+
+	if (count < sizeof(rec))
+		return -EINVAL;
+
+	if (nonblock && kfifo_is_empty(&client->events))
+		return -EAGAIN;
+	res = wait_event_interruptible(data->pDev.wq, !kfifo_is_empty(&client->events));
+	if (res < 0)
+		return res;
+
+	while (read + sizeof(rec) <= count) {
+		spin_lock_irq(&data->pDev.clientLock);
+		res = kfifo_get(&client->events, &rec);
+		if (res && (rec.usFlags & FAD_EVENT_FLAG_WAKEUP))
+			RelaxIrqWake(&data->pDev, client);
+		spin_unlock_irq(&data->pDev.clientLock);
+		if (!res)
+			break;
+		if (copy_to_user(buf + read, &rec, sizeof(rec)))
+			return read ? read : -EFAULT;
+		read += sizeof(rec);
+	}
+	return read;
 }
 
 /**
@@ -889,20 +1968,30 @@ static unsigned int FadPoll(struct file *filep, poll_table *pt)
 static ssize_t FadRead(struct file *filep, char *buf, size_t count,
 		       loff_t *f_pos)
 {
-	struct faddata *data = container_of(filep->private_data, struct faddata, miscdev);
+	struct fadclient *client = filep->private_data;
+	struct faddata *data = client->data;
 	struct device *dev = data->dev;
+	FAD_EVENT_E event;
 	int res;
 
+	if (client->bRecords)
+		return FadReadRecords(client, buf, count, filep->f_flags & O_NONBLOCK);
+
 	if (count < 1)
 		return -EINVAL;
 	res = wait_event_interruptible(data->pDev.wq, data->pDev.eEvent != FAD_NO_EVENT);
 	if (res < 0)
 		return res;
-	res = copy_to_user((void *)buf,  &data->pDev.eEvent, 1);
-	if (res < 0)
-		dev_err(dev, "copy-to-user failed: %i\n", res);
 
+	spin_lock_irq(&data->pDev.clientLock);
+	event = data->pDev.eEvent;
 	data->pDev.eEvent = FAD_NO_EVENT;
+	RelaxIrqWake(&data->pDev, NULL);
+	spin_unlock_irq(&data->pDev.clientLock);
+
+	res = copy_to_user((void *)buf, &event, 1);
+	if (res < 0)
+		dev_err(dev, "copy-to-user failed: %i\n", res);
 	return 1;
 }
 
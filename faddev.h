@@ -111,13 +111,106 @@ typedef enum {
 	FAD_NO_EVENT,
 	FAD_RESET_EVENT,
 	FAD_LASER_EVENT,
-	FAD_DIGIN_EVENT
+	FAD_DIGIN_EVENT,
+	FAD_TRIGGER_PRESS_EVENT,
+	FAD_TRIGGER_RELEASE_EVENT,        // ulData[0] = press duration [us]
+	FAD_TRIGGER_LONG_PRESS_EVENT,     // ulData[0] = held time [us]
+	FAD_TRIGGER_DOUBLE_PRESS_EVENT,   // ulData[0] = release-to-press gap [us]
+	FAD_SUSPEND_PREPARE_EVENT,        // Ack with IOCTL_FAD_SUSPEND_ACK
+	FAD_RESUMED_EVENT,                // ulData[0] = WAKE_REASON
+	FAD_CHARGE_MODE_EVENT,            // ulData[0] = WAKE_REASON
+	FAD_TIMELAPSE_WAKE_EVENT,         // ulData[0] = wake count, ack with IOCTL_FAD_TIMELAPSE_ACK
+	FAD_LDM_MEASUREMENT_EVENT,        // ulData[0] = distance [mm] or FAD_LDM_NO_DISTANCE, ulData[1] = quality or errno
+	FAD_LDM_MODE_EVENT                // ulData[0] = FADDEVIOCTLLASERMODES, ulData[1] = accuracy | FAD_LDM_MODE_CONTINUOUS
 } FAD_EVENT_E;
 
+#define FAD_LDM_NO_DISTANCE	0xFFFFFFFF	// Measurement failed, ulData[1] = errno
+#define FAD_LDM_MODE_CONTINUOUS	0x100		// FAD_LDM_MODE_EVENT, measuring continuously
+
+// Reason for leaving standby, reported in power state events
+enum WAKE_REASON {
+	UNKNOWN_WAKE,
+	ON_OFF_BUTTON_WAKE,
+	USB_CABLE_WAKE,
+	TIMELAPSE_WAKE,
+	RTC_WAKE,		// Standby timer, reported as ON_OFF_BUTTON_WAKE
+	INPUT_WAKE		// Trigger or laser input, see FAD_EVENT_FLAG_WAKEUP
+};
+
+// Event record returned by read() once IOCTL_FAD_SET_EVENT_RECORDS is enabled
+#define FAD_EVENT_FLAG_OVERRUN	0x0001	// Older records were dropped before this one
+#define FAD_EVENT_FLAG_WAKEUP	0x0002	// Edge woke the camera
+
+typedef struct _FADDEVEVENT {
+	USHORT      usEvent;        // FAD_EVENT_E
+	USHORT      usFlags;        // FAD_EVENT_FLAG_xxx
+	DWORD       ulSeq;          // Incremented for every queued record
+	DWORD       ulData[2];      // Event specific data
+	ULONGLONG   ullTimestamp;   // CLOCK_MONOTONIC time of event [ns]
+} FADDEVEVENT, *PFADDEVEVENT;
+
+typedef struct _FADDEVIOCTLFOCUSMOTOR {
+	BOOL	bMotorPowered;
+} FADDEVIOCTLFOCUSMOTOR, *PFADDEVIOCTLFOCUSMOTOR;
+
+// Loads accounted in FADDEVIOCTLLOADSTATS
+typedef enum {
+	FAD_LOAD_LASER,
+	FAD_LOAD_OPTICS,                  // Focus optics and sensor rails
+	FAD_LOAD_MOTOR,                   // Focus motor rail
+	FAD_LOAD_RED_LED,
+	FAD_LOAD_BLUE_LED,
+	FAD_LOAD_BUZZER,
+	FAD_LOADS
+} FAD_LOAD_E;
+
+#define FAD_MAX_LOADS	8
+
+typedef struct _FADDEVLOADSTAT {
+	ULONGLONG   ullOnTime;      // Total on time incl. current period [ns]
+	DWORD       ulTransitions;  // Number of on/off switches
+	BOOL        bOn;
+} FADDEVLOADSTAT, *PFADDEVLOADSTAT;
+
+typedef struct _FADDEVIOCTLLOADSTATS {
+	ULONGLONG   ullTimestamp;   // CLOCK_BOOTTIME of snapshot [ns]
+	DWORD       ulLoads;        // Valid entries in load[], FAD_LOAD_E index
+	DWORD       ulReserved;
+	FADDEVLOADSTAT load[FAD_MAX_LOADS];
+} FADDEVIOCTLLOADSTATS, *PFADDEVIOCTLLOADSTATS;
+
+// KAKA LED patterns, both LEDs follow one timeline
+#define FAD_LED_MAX_PATTERNS	8
+#define FAD_LED_MAX_STEPS	16
+#define FAD_LED_PATTERN_STOP	0xFFFFFFFF	// IOCTL_FAD_START_LED_PATTERN id to stop
+
+typedef struct _FADDEVLEDSTEP {
+	UCHAR       ucRed;          // Brightness 0-255
+	UCHAR       ucBlue;         // Brightness 0-255 (green LED on Bellatrix)
+	USHORT      usTimeMs;       // Step duration [ms], >0
+} FADDEVLEDSTEP, *PFADDEVLEDSTEP;
+
+typedef struct _FADDEVIOCTLLEDPATTERN {
+	DWORD       ulId;           // 0..FAD_LED_MAX_PATTERNS-1
+	DWORD       ulRepeat;       // Times to run pattern, 0 = until stopped
+	DWORD       ulSteps;        // Valid entries in step[]
+	FADDEVLEDSTEP step[FAD_LED_MAX_STEPS];
+} FADDEVIOCTLLEDPATTERN, *PFADDEVIOCTLLEDPATTERN;
+
 typedef struct _FADDEVIOCTLSUBJBACKLIGHT {
 	SUBJ_KEYPAD_BACKL_E	subjectiveBacklight;
 } FADDEVIOCTLSUBJBACKLIGHT, *PFADDEVIOCTLSUBJBACKLIGHT;
 
+// Keypad backlight steps, ordered by brightness. Step 0 is off, steps
+// 1..ulSteps are the DT "keypad-backlight-levels". KP_SUBJ_LOW, _MEDIUM
+// and _HIGH are the first, middle and last step.
+#define FAD_KP_STEP_OFF		0
+
+typedef struct _FADDEVIOCTLKPSTEP {
+	DWORD       ulStep;         // FAD_KP_STEP_OFF, 1..ulSteps
+	DWORD       ulSteps;        // OUT: Number of steps above off
+} FADDEVIOCTLKPSTEP, *PFADDEVIOCTLKPSTEP;
+
 #define INITIAL_VERSION 101
 // version 100 uses BOOL on the CFC levels below...
 typedef struct _FADDEVIOCTLSECURITY {
@@ -148,6 +241,13 @@ typedef struct _FADDEVIOCTLLASERMODE {
 	FADDEVIOCTLLASERMODEACCURACY accuracy;
 } FADDEVIOCTLLASERMODE, *PFADDEVIOCTLLASERMODE;
 
+#define FAD_PM_CLIENT_NAME_LEN 16
+
+typedef struct _FADDEVIOCTLPMCLIENT {
+	char    szName[FAD_PM_CLIENT_NAME_LEN];  // Reported if client is slow or fails
+	DWORD   ulTimeoutMs;    // Max wait for IOCTL_FAD_SUSPEND_ACK, 0 = unregister
+} FADDEVIOCTLPMCLIENT, *PFADDEVIOCTLPMCLIENT;
+
 // The diffrent power-state we can when we use the Truck Mounted Charger in Fenix.
 typedef enum { TC_HANDHELD, TC_PRODUCTION, TC_IN_TC_POWER, TC_IN_TC_NOPOWER} FADDEVIOCTLTCPOWERSTATES;
 
@@ -231,6 +331,16 @@ typedef enum { TC_HANDHELD, TC_PRODUCTION, TC_IN_TC_POWER, TC_IN_TC_NOPOWER} FAD
 #define IOCTL_FAD_RELEASE_READ          FAD_IOCTL_N(49)
 #define IOCTL_FAD_GET_TRIG_PRESSED      FAD_IOCTL_R(50, FADDEVIOCTLTRIGPRESSED)
 #define IOCTL_FAD_SET_LASER_MODE        FAD_IOCTL_W(51, FADDEVIOCTLLASERMODE)
+#define IOCTL_FAD_SET_EVENT_RECORDS     FAD_IOCTL_W(52, DWORD)	// TRUE = read() returns FADDEVEVENT
+#define IOCTL_FAD_SUSPEND_ACK           FAD_IOCTL_W(53, DWORD)	// TRUE = ready for standby, FALSE = fail
+#define IOCTL_FAD_REGISTER_PM_CLIENT    FAD_IOCTL_W(54, FADDEVIOCTLPMCLIENT)
+#define IOCTL_FAD_SET_FOCUS_MOTOR       FAD_IOCTL_W(55, FADDEVIOCTLFOCUSMOTOR)
+#define IOCTL_FAD_TIMELAPSE_ACK         FAD_IOCTL_W(56, DWORD)	// TRUE = window done, may suspend, FALSE = stay awake
+#define IOCTL_FAD_GET_LOAD_STATS        FAD_IOCTL_R(57, FADDEVIOCTLLOADSTATS)
+#define IOCTL_FAD_SET_LED_PATTERN       FAD_IOCTL_W(58, FADDEVIOCTLLEDPATTERN)
+#define IOCTL_FAD_START_LED_PATTERN     FAD_IOCTL_W(59, DWORD)	// Pattern id or FAD_LED_PATTERN_STOP
+#define IOCTL_FAD_GET_KP_STEP           FAD_IOCTL_R(60, FADDEVIOCTLKPSTEP)
+#define IOCTL_FAD_SET_KP_STEP           FAD_IOCTL_W(61, FADDEVIOCTLKPSTEP)
 
 // DeviceIoControl wrapper for CE/Linux/BTZCAMSIM crosscompatibility
 
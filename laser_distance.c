@@ -26,21 +26,52 @@
 #endif
 #include <linux/leds.h>
 #include <linux/platform_device.h>
-#include <linux/input.h>
+#include <linux/module.h>
+#include "fad_ldm.h"
 
 #define ENOLASERIRQ 1
+#define LDM_STATE_OFF	-1
 
-extern struct input_dev *ca111_get_input_dev(void);
-extern int ca111_get_laserstatus(void);
+// Registered laser distance module, see fad_ldm.h
+static struct {
+	struct mutex lock;		// Held across ops calls and (un)register
+	const struct fad_ldm_ops *ops;
+	void *priv;
+	spinlock_t resultLock;		// fad_ldm_report() may run in atomic context
+	PFAD_HW_INDEP_INFO gpDev;
+	// Results to event records, at most maxRateHz, newest result wins
+	u32 maxRateHz;			// 0 = every result
+	ktime_t lastSent;
+	struct fad_ldm_result pending;
+	BOOL bPending;
+	struct hrtimer rateTimer;
+	// Laser state, changed with both lock and resultLock held
+	int state;			// LDM_STATE_OFF or enum fad_ldm_mode
+	enum fad_ldm_accuracy accuracy;
+	DWORD modeData[2];		// FAD_LDM_MODE_EVENT data of state
+	BOOL bModeEvent;		// Send FAD_LDM_MODE_EVENT with next result
+	// Periodic single measurements, see fad_ldm_set_sample_interval()
+	u32 sampleIntervalMs;		// 0 = off
+	u32 maxDutyPct;			// Limit of laser on-time, 0 = none
+	struct hrtimer sampleTimer;
+	struct work_struct sampleWork;
+	ktime_t shotStart;
+	BOOL bSampleShot;		// Measurement started by sampling running
+	unsigned long samplePaused;	// BIT(FAD_LDM_PAUSE_xxx)
+} fad_ldm = {
+	.lock = __MUTEX_INITIALIZER(fad_ldm.lock),
+	.resultLock = __SPIN_LOCK_UNLOCKED(fad_ldm.resultLock),
+	.state = LDM_STATE_OFF,
+	.modeData = { ~0U, ~0U },
+};
 
 void startlaser(PFAD_HW_INDEP_INFO gpDev);
 void stoplaser(void);
-void startmeasure(int key, int value);
 void stopmeasure(void);
 void startmeasure_hq_continous(void);
-void startmeasure_hq_single(void);
+int startmeasure_hq_single(void);
 void startmeasure_lq_continous(void);
-void startmeasure_lq_single(void);
+int startmeasure_lq_single(void);
 
 void setLaserDistanceStatus(PFAD_HW_INDEP_INFO gpDev, BOOL on)
 {
@@ -49,22 +80,291 @@ void setLaserDistanceStatus(PFAD_HW_INDEP_INFO gpDev, BOOL on)
 	} else {
 		gpDev->bLaserEnable = false;
 		stoplaser();
+		fad_load_src_set(gpDev, FAD_LOAD_LASER, FAD_LASER_SRC_ACTIVE, FALSE);
 	}
 }
 
+/**
+ * Register laser distance module, called by its driver at probe
+ *
+ * @param ops
+ * @param priv  Passed back to ops
+ *
+ * @return 0, -EBUSY if a module is already registered
+ */
+int fad_ldm_register(const struct fad_ldm_ops *ops, void *priv)
+{
+	int ret = 0;
+
+	mutex_lock(&fad_ldm.lock);
+	if (fad_ldm.ops) {
+		ret = -EBUSY;
+	} else {
+		fad_ldm.ops = ops;
+		fad_ldm.priv = priv;
+	}
+	mutex_unlock(&fad_ldm.lock);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(fad_ldm_register);
+
+void fad_ldm_unregister(const struct fad_ldm_ops *ops)
+{
+	mutex_lock(&fad_ldm.lock);
+	if (fad_ldm.ops == ops) {
+		fad_ldm.ops = NULL;
+		fad_ldm.priv = NULL;
+	}
+	mutex_unlock(&fad_ldm.lock);
+}
+EXPORT_SYMBOL_GPL(fad_ldm_unregister);
+
+// Called with resultLock held
+static void ldm_send(PFAD_HW_INDEP_INFO gpDev, const struct fad_ldm_result *result,
+		     ktime_t now)
+{
+	ktime_t ts = ktime_to_ns(result->timestamp) ? result->timestamp : now;
+
+	fad_ldm.lastSent = now;
+	fad_ldm.bPending = FALSE;
+	if (result->status)
+		ApplicationEventRecord(gpDev, FAD_LDM_MEASUREMENT_EVENT, ts,
+				       FAD_LDM_NO_DISTANCE, -result->status);
+	else
+		ApplicationEventRecord(gpDev, FAD_LDM_MEASUREMENT_EVENT, ts,
+				       result->distance_mm, result->quality);
+}
+
+// Called with resultLock held
+static void ldm_mode_event(PFAD_HW_INDEP_INFO gpDev, ktime_t ts)
+{
+	fad_ldm.bModeEvent = FALSE;
+	ApplicationEventRecord(gpDev, FAD_LDM_MODE_EVENT, ts,
+			       fad_ldm.modeData[0], fad_ldm.modeData[1]);
+}
+
+static enum hrtimer_restart ldm_rate_timer(struct hrtimer *timer)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&fad_ldm.resultLock, flags);
+	if (fad_ldm.bPending && fad_ldm.gpDev)
+		ldm_send(fad_ldm.gpDev, &fad_ldm.pending, ktime_get());
+	spin_unlock_irqrestore(&fad_ldm.resultLock, flags);
+	return HRTIMER_NORESTART;
+}
+
+u32 fad_ldm_get_max_rate(void)
+{
+	return fad_ldm.maxRateHz;
+}
+
+void fad_ldm_set_max_rate(u32 hz)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&fad_ldm.resultLock, flags);
+	fad_ldm.maxRateHz = hz;
+	spin_unlock_irqrestore(&fad_ldm.resultLock, flags);
+}
+
+/*
+ * Sampling shot done after onUs of laser on-time, called with resultLock
+ * held. Next shot after the interval, or later if the duty-cycle limit
+ * needs it.
+ */
+static void ldm_sample_done(PFAD_HW_INDEP_INFO gpDev, ktime_t now)
+{
+	s64 onUs = ktime_us_delta(now, fad_ldm.shotStart);
+	s64 period = (s64)fad_ldm.sampleIntervalMs * USEC_PER_MSEC;
+
+	fad_ldm.bSampleShot = FALSE;
+	fad_load_src_set(gpDev, FAD_LOAD_LASER, FAD_LASER_SRC_SAMPLE, FALSE);
+	if (!fad_ldm.sampleIntervalMs || fad_ldm.samplePaused)
+		return;
+	if (fad_ldm.maxDutyPct && fad_ldm.maxDutyPct < 100)
+		period = max_t(s64, period, div_u64(onUs * 100, fad_ldm.maxDutyPct));
+	hrtimer_start(&fad_ldm.sampleTimer, ktime_add_us(fad_ldm.shotStart, period),
+		      HRTIMER_MODE_ABS);
+}
+
+/**
+ * Measurement result from the module driver, any context.
+ * Queued to clients as FAD_LDM_MEASUREMENT_EVENT, rate capped by
+ * fad_ldm_set_max_rate().
+ *
+ * @param result
+ */
+void fad_ldm_report(const struct fad_ldm_result *result)
+{
+	unsigned long flags;
+	ktime_t now = ktime_get();
+
+	spin_lock_irqsave(&fad_ldm.resultLock, flags);
+	// Module turns laser off after a single measurement
+	if (fad_ldm.state == FAD_LDM_SINGLE)
+		fad_ldm.state = LDM_STATE_OFF;
+	if (!fad_ldm.gpDev)
+		goto out;
+
+	// First result in a new mode, the change has taken effect
+	if (fad_ldm.bModeEvent)
+		ldm_mode_event(fad_ldm.gpDev, now);
+	if (fad_ldm.bSampleShot)
+		ldm_sample_done(fad_ldm.gpDev, now);
+
+	if (fad_ldm.maxRateHz) {
+		s64 period = USEC_PER_SEC / fad_ldm.maxRateHz;
+
+		if (ktime_us_delta(now, fad_ldm.lastSent) < period) {
+			// Too soon, send when the period has passed
+			fad_ldm.pending = *result;
+			if (!fad_ldm.bPending) {
+				fad_ldm.bPending = TRUE;
+				hrtimer_start(&fad_ldm.rateTimer,
+					      ktime_add_us(fad_ldm.lastSent, period),
+					      HRTIMER_MODE_ABS);
+			}
+			goto out;
+		}
+	}
+	ldm_send(fad_ldm.gpDev, result, now);
+out:
+	spin_unlock_irqrestore(&fad_ldm.resultLock, flags);
+}
+EXPORT_SYMBOL_GPL(fad_ldm_report);
+
+/*
+ * Move the laser to mode and accuracy, called with lock held and a
+ * module registered. A running measurement is changed in place with a
+ * single start command, the module is only stopped and restarted if it
+ * refuses that. FAD_LDM_MODE_EVENT is sent when the new mode takes
+ * effect: at once for pointer, with the first result for measurements.
+ */
+static int ldm_start_locked(enum fad_ldm_mode mode, enum fad_ldm_accuracy accuracy)
+{
+	unsigned long flags;
+	int ret;
+
+	if (fad_ldm.state == mode && fad_ldm.accuracy == accuracy &&
+	    mode != FAD_LDM_SINGLE)
+		return 0;
+
+	ret = fad_ldm.ops->start(fad_ldm.priv, mode, accuracy);
+	if (ret && fad_ldm.state != LDM_STATE_OFF) {
+		pr_debug("%s: Mode change refused (%d), restarting\n", __func__, ret);
+		fad_ldm.ops->stop(fad_ldm.priv);
+		ret = fad_ldm.ops->start(fad_ldm.priv, mode, accuracy);
+	}
+
+	spin_lock_irqsave(&fad_ldm.resultLock, flags);
+	if (ret) {
+		fad_ldm.state = LDM_STATE_OFF;
+		fad_ldm.modeData[0] = fad_ldm.modeData[1] = ~0U;
+		fad_ldm.bModeEvent = FALSE;
+	} else {
+		DWORD data[2];
+
+		fad_ldm.state = mode;
+		fad_ldm.accuracy = accuracy;
+		if (mode == FAD_LDM_POINTER) {
+			data[0] = LASERMODE_POINTER;
+			data[1] = LASERMODE_DISTANCE_NONE;
+		} else {
+			data[0] = LASERMODE_DISTANCE;
+			data[1] = accuracy == FAD_LDM_HIGH_ACCURACY ?
+				LASERMODE_DISTANCE_HIGH_ACCURACY : LASERMODE_DISTANCE_LOW_ACCURACY;
+			if (mode == FAD_LDM_CONTINUOUS)
+				data[1] |= FAD_LDM_MODE_CONTINUOUS;
+		}
+		// Repeated single measurements are not a mode change
+		if (data[0] != fad_ldm.modeData[0] || data[1] != fad_ldm.modeData[1]) {
+			fad_ldm.modeData[0] = data[0];
+			fad_ldm.modeData[1] = data[1];
+			fad_ldm.bModeEvent = TRUE;
+		}
+		if (fad_ldm.bModeEvent && mode == FAD_LDM_POINTER && fad_ldm.gpDev)
+			ldm_mode_event(fad_ldm.gpDev, ktime_get());
+	}
+	spin_unlock_irqrestore(&fad_ldm.resultLock, flags);
+	return ret;
+}
+
+static int ldm_start(enum fad_ldm_mode mode, enum fad_ldm_accuracy accuracy)
+{
+	int ret = -ENODEV;
+
+	mutex_lock(&fad_ldm.lock);
+	if (fad_ldm.ops)
+		ret = ldm_start_locked(mode, accuracy);
+	mutex_unlock(&fad_ldm.lock);
+	if (ret)
+		pr_err("%s: Laser distance module start failed (%d)\n", __func__, ret);
+	return ret;
+}
+
+/*
+ * Start a sampling shot, only if the laser is off. Checked under lock
+ * so a client start cannot slip in between.
+ *
+ * @return 0, -EBUSY if the laser is in use
+ */
+static int ldm_start_sample(PFAD_HW_INDEP_INFO gpDev, enum fad_ldm_accuracy accuracy,
+			    ktime_t now)
+{
+	unsigned long flags;
+	int ret = -ENODEV;
+
+	mutex_lock(&fad_ldm.lock);
+	if (!fad_ldm.ops)
+		goto out;
+	ret = -EBUSY;
+	if (fad_ldm.state != LDM_STATE_OFF)
+		goto out;
+
+	spin_lock_irqsave(&fad_ldm.resultLock, flags);
+	fad_ldm.bSampleShot = TRUE;
+	fad_ldm.shotStart = now;
+	spin_unlock_irqrestore(&fad_ldm.resultLock, flags);
+	fad_load_src_set(gpDev, FAD_LOAD_LASER, FAD_LASER_SRC_SAMPLE, TRUE);
+
+	ret = ldm_start_locked(FAD_LDM_SINGLE, accuracy);
+	if (ret) {
+		pr_err("%s: Laser distance module start failed (%d)\n", __func__, ret);
+		spin_lock_irqsave(&fad_ldm.resultLock, flags);
+		if (fad_ldm.bSampleShot)
+			ldm_sample_done(gpDev, ktime_get());
+		spin_unlock_irqrestore(&fad_ldm.resultLock, flags);
+	}
+out:
+	mutex_unlock(&fad_ldm.lock);
+	return ret;
+}
+
+static inline BOOL ldm_running(void)
+{
+	return READ_ONCE(fad_ldm.state) != LDM_STATE_OFF;
+}
+
+static int ldm_get_status(void)
+{
+	int ret = -ENODEV;
+
+	mutex_lock(&fad_ldm.lock);
+	if (fad_ldm.ops)
+		ret = fad_ldm.ops->get_status(fad_ldm.priv);
+	mutex_unlock(&fad_ldm.lock);
+	return ret;
+}
+
 void getLaserDistanceStatus(PFAD_HW_INDEP_INFO gpDev, PFADDEVIOCTLLASER pLaserStatus)
 {
-#if defined(CONFIG_CA111)
-	int state;
+	int state = ldm_get_status();
 
-	msleep(100);
-	state = ca111_get_laserstatus();
-	pLaserStatus->bLaserIsOn = state;	//if laser is on
+	if (state < 0)
+		pr_err("%s: No laser distance module (%d)\n", __func__, state);
+	pLaserStatus->bLaserIsOn = state > 0;	//if laser is on
 	pLaserStatus->bLaserPowerEnabled = true;	// if switch is pressed...
-#else
-	pr_err("%s: CA111 Module not loaded, no Laser Distance Meter\n",
-	       __func__);
-#endif
 }
 
 void SetLaserDistanceActive(PFAD_HW_INDEP_INFO gpDev, BOOL on)
@@ -77,9 +377,11 @@ void SetLaserDistanceActive(PFAD_HW_INDEP_INFO gpDev, BOOL on)
 			pr_debug("%s: Turning laser off", __func__);
 			stoplaser();
 		}
+		fad_load_src_set(gpDev, FAD_LOAD_LASER, FAD_LASER_SRC_ACTIVE, on);
 	} else {
 		pr_debug("%s: Turning laser off", __func__);
 		stoplaser();
+		fad_load_src_set(gpDev, FAD_LOAD_LASER, FAD_LASER_SRC_ACTIVE, FALSE);
 	}
 }
 
@@ -94,9 +396,22 @@ BOOL GetLaserDistanceActive(PFAD_HW_INDEP_INFO gpDev)
 void startlaser(PFAD_HW_INDEP_INFO gpDev)
 {
 #ifdef CONFIG_OF
+	unsigned long flags;
+	BOOL bShot;
+
+	// Client takes over a sampling shot in flight, and its laser load
+	spin_lock_irqsave(&fad_ldm.resultLock, flags);
+	bShot = fad_ldm.bSampleShot;
+	fad_ldm.bSampleShot = FALSE;
+	spin_unlock_irqrestore(&fad_ldm.resultLock, flags);
+	if (bShot) {
+		fad_load_src_set(gpDev, FAD_LOAD_LASER, FAD_LASER_SRC_ACTIVE, TRUE);
+		fad_load_src_set(gpDev, FAD_LOAD_LASER, FAD_LASER_SRC_SAMPLE, FALSE);
+	}
+
 	switch (gpDev->laserMode) {
 	case LASERMODE_POINTER:
-		startmeasure(MSC_RAW, 1);
+		ldm_start(FAD_LDM_POINTER, FAD_LDM_LOW_ACCURACY);
 		break;
 	case LASERMODE_DISTANCE:
 		switch (gpDev->ldmAccuracy) {
@@ -135,51 +450,197 @@ void stoplaser(void)
 
 void stopmeasure(void)
 {
-	startmeasure(MSC_RAW, 0);
+	unsigned long flags;
+	int ret = -ENODEV;
+
+	mutex_lock(&fad_ldm.lock);
+	if (fad_ldm.ops)
+		ret = fad_ldm.ops->stop(fad_ldm.priv);
+	spin_lock_irqsave(&fad_ldm.resultLock, flags);
+	fad_ldm.state = LDM_STATE_OFF;
+	// Next start reports its mode again, nothing pending for this one
+	fad_ldm.modeData[0] = fad_ldm.modeData[1] = ~0U;
+	fad_ldm.bModeEvent = FALSE;
+	spin_unlock_irqrestore(&fad_ldm.resultLock, flags);
+	mutex_unlock(&fad_ldm.lock);
+	if (ret)
+		pr_err("%s: Laser distance module stop failed (%d)\n", __func__, ret);
 }
 
-void startmeasure(int key, int value)
+int startmeasure_hq_single(void)
 {
-#if defined(CONFIG_CA111)
-	struct input_dev *button_dev = ca111_get_input_dev();
+	return ldm_start(FAD_LDM_SINGLE, FAD_LDM_HIGH_ACCURACY);
+}
 
-	if (button_dev) {
-		input_event(button_dev, EV_MSC, key, value);
-	} else {
-		pr_err("fad %s: ca111 input_dev is NULL\n", __func__);
+void startmeasure_hq_continous(void)
+{
+	ldm_start(FAD_LDM_CONTINUOUS, FAD_LDM_HIGH_ACCURACY);
+}
+
+int startmeasure_lq_single(void)
+{
+	return ldm_start(FAD_LDM_SINGLE, FAD_LDM_LOW_ACCURACY);
+}
+
+void startmeasure_lq_continous(void)
+{
+	ldm_start(FAD_LDM_CONTINUOUS, FAD_LDM_LOW_ACCURACY);
+}
+
+static enum hrtimer_restart ldm_sample_timer(struct hrtimer *timer)
+{
+	schedule_work(&fad_ldm.sampleWork);
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * One sampling shot. The timer is armed for the next shot first, a
+ * result moves it later if the duty-cycle limit needs it, and a shot
+ * still without result when it fires is stopped.
+ */
+static void ldm_sample_work(struct work_struct *work)
+{
+	PFAD_HW_INDEP_INFO gpDev = READ_ONCE(fad_ldm.gpDev);
+	u32 interval = READ_ONCE(fad_ldm.sampleIntervalMs);
+	unsigned long flags;
+	ktime_t now = ktime_get();
+	BOOL bHigh = FALSE;
+
+	if (!gpDev || !interval || READ_ONCE(fad_ldm.samplePaused))
+		return;
+
+	spin_lock_irqsave(&fad_ldm.resultLock, flags);
+	if (fad_ldm.bSampleShot) {
+		ldm_sample_done(gpDev, now);
+		spin_unlock_irqrestore(&fad_ldm.resultLock, flags);
+		pr_debug("%s: No result from laser distance module\n", __func__);
+		stopmeasure();
+		return;
 	}
-#else
-	pr_err("%s: CA111 Module not loaded, no Laser Distance Meter\n",
-	       __func__);
+	spin_unlock_irqrestore(&fad_ldm.resultLock, flags);
+
+	hrtimer_start(&fad_ldm.sampleTimer, ktime_add_us(now, (s64)interval * USEC_PER_MSEC),
+		      HRTIMER_MODE_ABS);
+
+	// Laser disabled, or in use by a client (checked again under lock)
+	if (!gpDev->bLaserEnable || ldm_running())
+		return;
+
+#ifdef CONFIG_OF
+	bHigh = gpDev->ldmAccuracy == LASERMODE_DISTANCE_HIGH_ACCURACY;
 #endif
+	ldm_start_sample(gpDev, bHigh ? FAD_LDM_HIGH_ACCURACY : FAD_LDM_LOW_ACCURACY, now);
 }
 
-void startmeasure_hq_single(void)
+u32 fad_ldm_get_sample_interval(void)
 {
-	startmeasure(MSC_PULSELED, 1);
+	return fad_ldm.sampleIntervalMs;
 }
 
-void startmeasure_hq_continous(void)
+/**
+ * Measure periodically with single measurements, accuracy as set with
+ * IOCTL_FAD_SET_LASER_MODE. Skipped while a client has the laser on.
+ *
+ * @param ms  Interval, 0 stops sampling
+ */
+void fad_ldm_set_sample_interval(u32 ms)
 {
-	startmeasure(MSC_PULSELED, 2);
+	// Timer and work exist once SetupLaserDistance() has run
+	if (fad_ldm.gpDev) {
+		WRITE_ONCE(fad_ldm.sampleIntervalMs, 0);
+		hrtimer_cancel(&fad_ldm.sampleTimer);
+		cancel_work_sync(&fad_ldm.sampleWork);
+		hrtimer_cancel(&fad_ldm.sampleTimer);
+	}
+
+	WRITE_ONCE(fad_ldm.sampleIntervalMs, ms);
+	if (ms && fad_ldm.gpDev)
+		schedule_work(&fad_ldm.sampleWork);
 }
 
-void startmeasure_lq_single(void)
+/**
+ * Pause sampling for a reason, resumed when no reason is left.
+ * A shot in flight is stopped. The interval is kept.
+ *
+ * @param reason  FAD_LDM_PAUSE_xxx
+ * @param pause
+ */
+void fad_ldm_pause_sampling(enum fad_ldm_pause reason, BOOL pause)
 {
-	startmeasure(MSC_GESTURE, 1);
+	PFAD_HW_INDEP_INFO gpDev = fad_ldm.gpDev;
+	unsigned long flags;
+	BOOL bShot;
+
+	if (!gpDev)
+		return;
+
+	if (!pause) {
+		if (test_and_clear_bit(reason, &fad_ldm.samplePaused) &&
+		    !READ_ONCE(fad_ldm.samplePaused) && READ_ONCE(fad_ldm.sampleIntervalMs))
+			schedule_work(&fad_ldm.sampleWork);
+		return;
+	}
+
+	if (test_and_set_bit(reason, &fad_ldm.samplePaused))
+		return;
+	hrtimer_cancel(&fad_ldm.sampleTimer);
+	cancel_work_sync(&fad_ldm.sampleWork);
+	hrtimer_cancel(&fad_ldm.sampleTimer);
+
+	spin_lock_irqsave(&fad_ldm.resultLock, flags);
+	bShot = fad_ldm.bSampleShot;
+	if (bShot)
+		ldm_sample_done(gpDev, ktime_get());
+	spin_unlock_irqrestore(&fad_ldm.resultLock, flags);
+	if (bShot)
+		stopmeasure();
 }
 
-void startmeasure_lq_continous(void)
+u32 fad_ldm_get_max_duty(void)
 {
-	startmeasure(MSC_GESTURE, 2);
+	return fad_ldm.maxDutyPct;
 }
 
+/**
+ * Limit laser on-time of sampling, the interval is stretched when a
+ * measurement takes longer than the limit allows.
+ *
+ * @param pct  Percent of time, 0 for no limit
+ *
+ * @return 0, -EINVAL above 100
+ */
+int fad_ldm_set_max_duty(u32 pct)
+{
+	unsigned long flags;
+
+	if (pct > 100)
+		return -EINVAL;
+	spin_lock_irqsave(&fad_ldm.resultLock, flags);
+	fad_ldm.maxDutyPct = pct;
+	spin_unlock_irqrestore(&fad_ldm.resultLock, flags);
+	return 0;
+}
+
+/**
+ * Set laser mode, applied at once to a running laser without
+ * stopping it. Clients see FAD_LDM_MODE_EVENT when it takes effect.
+ *
+ * @param gpDev
+ * @param pLaserMode
+ */
 void setLaserDistanceMode(PFAD_HW_INDEP_INFO gpDev, PFADDEVIOCTLLASERMODE pLaserMode)
 {
 #ifdef CONFIG_OF
+	BOOL bChanged = gpDev->laserMode != pLaserMode->mode ||
+		gpDev->ldmAccuracy != pLaserMode->accuracy ||
+		!gpDev->ldmContinous != !pLaserMode->continousMeasurment;
+
 	gpDev->laserMode = pLaserMode->mode;
 	gpDev->ldmAccuracy = pLaserMode->accuracy;
 	gpDev->ldmContinous = pLaserMode->continousMeasurment;
+
+	if (bChanged && gpDev->bLaserEnable && ldm_running())
+		startlaser(gpDev);
 #endif
 }
 
@@ -193,5 +654,46 @@ int SetupLaserDistance(PFAD_HW_INDEP_INFO gpDev)
 	gpDev->pGetLaserActive = GetLaserDistanceActive;
 	gpDev->pSetLaserMode = setLaserDistanceMode;
 
+	hrtimer_init(&fad_ldm.rateTimer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	fad_ldm.rateTimer.function = ldm_rate_timer;
+	hrtimer_init(&fad_ldm.sampleTimer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	fad_ldm.sampleTimer.function = ldm_sample_timer;
+	INIT_WORK(&fad_ldm.sampleWork, ldm_sample_work);
+	fad_ldm.gpDev = gpDev;
+#ifdef CONFIG_OF
+	{
+		struct faddata *data = container_of(gpDev, struct faddata, pDev);
+		u32 val;
+
+		if (!of_property_read_u32(data->dev->of_node, "ldm-max-rate-hz", &val))
+			fad_ldm_set_max_rate(val);
+		if (!of_property_read_u32(data->dev->of_node, "ldm-max-duty-pct", &val) &&
+		    fad_ldm_set_max_duty(val))
+			pr_err("%s: Invalid ldm-max-duty-pct %u\n", __func__, val);
+		if (!of_property_read_u32(data->dev->of_node, "ldm-sample-interval-ms", &val))
+			fad_ldm_set_sample_interval(val);
+	}
+#endif
+	// Interval may have been set before the module was set up
+	if (fad_ldm.sampleIntervalMs)
+		schedule_work(&fad_ldm.sampleWork);
+
     return retval;
 }
+
+void InvSetupLaserDistance(PFAD_HW_INDEP_INFO gpDev)
+{
+	unsigned long flags;
+
+	fad_ldm_set_sample_interval(0);
+	if (gpDev->bLaserEnable)
+		stoplaser();
+	spin_lock_irqsave(&fad_ldm.resultLock, flags);
+	fad_ldm.bSampleShot = FALSE;
+	fad_ldm.gpDev = NULL;
+	fad_ldm.bPending = FALSE;
+	spin_unlock_irqrestore(&fad_ldm.resultLock, flags);
+	hrtimer_cancel(&fad_ldm.rateTimer);
+	fad_load_src_set(gpDev, FAD_LOAD_LASER, FAD_LASER_SRC_SAMPLE, FALSE);
+	fad_load_src_set(gpDev, FAD_LOAD_LASER, FAD_LASER_SRC_ACTIVE, FALSE);
+}
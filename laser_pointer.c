@@ -30,25 +30,71 @@
 
 #define ENOLASERIRQ 1
 
-void setLaserPointerStatus(PFAD_HW_INDEP_INFO gpDev, BOOL on)
+// Called with laserLock held
+static void fadLaserSwitch(PFAD_HW_INDEP_INFO gpDev, BOOL on)
 {
 #ifdef CONFIG_OF
-	if (gpDev->laser_switch_gpio)
+	if (test_bit(FAD_LASER_SWITCH, &gpDev->laserInhibit))
+		on = FALSE;
+	if (gpDev->laser_switch_gpio) {
 		gpio_set_value_cansleep(gpDev->laser_switch_gpio, on);
+		fad_load_src_set(gpDev, FAD_LOAD_LASER, FAD_LASER_SRC_SWITCH, on);
+	}
+#endif
+}
+
+// Called with laserLock held
+static void fadLaserSoft(PFAD_HW_INDEP_INFO gpDev)
+{
+#ifdef CONFIG_OF
+	if (gpDev->laser_soft_gpio)
+		gpio_set_value_cansleep(gpDev->laser_soft_gpio, gpDev->bLaserActive &&
+					!test_bit(FAD_LASER_SOFT, &gpDev->laserInhibit));
 #endif
 }
 
+// Called with laserLock held, software controlled laser only
+static void fadLaserUpdate(PFAD_HW_INDEP_INFO gpDev)
+{
+	FADDEVIOCTLLASER laserStatus = { 0 };
+
+	getLaserPointerStatus(gpDev, &laserStatus);
+	fadLaserSwitch(gpDev, laserStatus.bLaserIsOn && gpDev->bLaserEnable);
+}
+
+/**
+ * Laser enable from IOCTL_FAD_SET_LASER_STATUS. Set under laserLock,
+ * the laser IRQ thread gates the output on it.
+ *
+ * @param gpDev
+ * @param on
+ */
+void setLaserPointerStatus(PFAD_HW_INDEP_INFO gpDev, BOOL on)
+{
+	mutex_lock(&gpDev->laserLock);
+	gpDev->bLaserEnable = on;
+	// Software controlled laser, output follows button and enable
+	if (gpDev->bHasSoftwareControlledLaser)
+		fadLaserUpdate(gpDev);
+	else
+		fadLaserSwitch(gpDev, on);
+	mutex_unlock(&gpDev->laserLock);
+}
+
+/**
+ * Drive laser output from the laser button and the enable set by
+ * IOCTL_FAD_SET_LASER_STATUS. Called from the laser IRQ thread, so the
+ * beam follows the button without a round trip through userspace.
+ * Kept off while the charge profile inhibits the laser switch.
+ *
+ * @param gpDev
+ */
 void updateLaserPointerOutput(PFAD_HW_INDEP_INFO gpDev)
 {
 	if (gpDev->bHasSoftwareControlledLaser) {
-		FADDEVIOCTLLASER laserStatus = { 0 };
-		getLaserPointerStatus(gpDev, &laserStatus);
-
-		if (laserStatus.bLaserIsOn && laserStatus.bLaserPowerEnabled) {
-			setLaserPointerStatus(gpDev, 1);
-		} else {
-			setLaserPointerStatus(gpDev, 0);
-		}
+		mutex_lock(&gpDev->laserLock);
+		fadLaserUpdate(gpDev);
+		mutex_unlock(&gpDev->laserLock);
 	}
 }
 
@@ -62,8 +108,9 @@ void getLaserPointerStatus(PFAD_HW_INDEP_INFO gpDev, PFADDEVIOCTLLASER pLaserSta
 	pLaserStatus->bLaserIsOn = value;
 
 #ifdef CONFIG_OF
+	// Laser switch is active high, driven by fadLaserSwitch()
 	if (gpDev->laser_switch_gpio)
-		value = gpio_get_value_cansleep(gpDev->laser_switch_gpio == 0);
+		value = gpio_get_value_cansleep(gpDev->laser_switch_gpio);
 #endif
 	pLaserStatus->bLaserPowerEnabled = value;
 }
@@ -71,11 +118,10 @@ void getLaserPointerStatus(PFAD_HW_INDEP_INFO gpDev, PFADDEVIOCTLLASER pLaserSta
 
 void SetLaserPointerActive(PFAD_HW_INDEP_INFO gpDev, BOOL on)
 {
-#ifdef CONFIG_OF
-	if (gpDev->laser_soft_gpio) {
-		gpio_set_value_cansleep(gpDev->laser_soft_gpio, on);
-	}
-#endif
+	mutex_lock(&gpDev->laserLock);
+	gpDev->bLaserActive = on;
+	fadLaserSoft(gpDev);
+	mutex_unlock(&gpDev->laserLock);
 }
 
 BOOL GetLaserPointerActive(PFAD_HW_INDEP_INFO gpDev)
@@ -89,6 +135,26 @@ BOOL GetLaserPointerActive(PFAD_HW_INDEP_INFO gpDev)
 	return value;
 }
 
+/**
+ * Keep laser lines off (charge profile), or release them.
+ * Released lines follow the current requests, not the state at
+ * inhibit time.
+ *
+ * @param gpDev
+ * @param lines  BIT(FAD_LASER_xxx) to keep off, 0 for none
+ */
+void SetLaserPointerInhibit(PFAD_HW_INDEP_INFO gpDev, unsigned long lines)
+{
+	mutex_lock(&gpDev->laserLock);
+	gpDev->laserInhibit = lines;
+	fadLaserSoft(gpDev);
+	if (gpDev->bHasSoftwareControlledLaser)
+		fadLaserUpdate(gpDev);
+	else
+		fadLaserSwitch(gpDev, gpDev->bLaserEnable);
+	mutex_unlock(&gpDev->laserLock);
+}
+
 int SetupLaserPointer(PFAD_HW_INDEP_INFO gpDev)
 {
 	int retval = 0;
@@ -118,6 +184,8 @@ int SetupLaserPointer(PFAD_HW_INDEP_INFO gpDev)
 			gpDev->laser_on_gpio = pin;
 			gpio_request(pin, "LaserON");
 			gpio_direction_input(pin);
+			gpDev->bLaserWakeup = of_property_read_bool(dev->of_node,
+								    "laser-wakeup");
 			retval = InitLaserIrq(gpDev);
 			if (retval) {
 				pr_err("flirdrv-fad: Failed to request Laser IRQ\n");